@@ -0,0 +1,150 @@
+#pragma once
+
+// the spring, like and buddy lists of particle.cpp: a dense array of links
+// that the force loops walk, plus a hash from particle pair to array slot so
+// a pair can only be linked once and any link can be removed in O(1) by
+// moving the last one into its place. i-j and j-i are the same pair.
+//
+// removals leave the array in whatever order the swaps made; compact()
+// sorts it by particle so the force loops walk positions mostly in order.
+
+#include <algorithm>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+template <class Link>
+class EdgeSet
+{
+public:
+  // false if the pair is linked already
+  bool add(const Link &link)
+  {
+    if (link.i == link.j)
+      return false;
+    if (!slot.emplace(key(link.i, link.j), int(links.size())).second)
+      return false;
+    links.push_back(link);
+    return true;
+  }
+
+  // adds every link whose pair is new; returns how many that was
+  template <class It>
+  int add(It begin, It end)
+  {
+    links.reserve(links.size() + (end - begin));
+    slot.reserve(links.size() + (end - begin));
+    int added = 0;
+    for (It it = begin; it != end; ++it)
+      added += add(*it);
+    return added;
+  }
+
+  bool contains(int i, int j) const { return slot.count(key(i, j)) > 0; }
+
+  bool remove(int i, int j)
+  {
+    auto found = slot.find(key(i, j));
+    if (found == slot.end())
+      return false;
+    removeAt(found->second);
+    return true;
+  }
+
+  // the last link moves into slot k
+  void removeAt(int k)
+  {
+    slot.erase(key(links[k].i, links[k].j));
+    if (k != int(links.size()) - 1)
+    {
+      links[k] = links.back();
+      slot[key(links[k].i, links[k].j)] = k;
+    }
+    links.pop_back();
+  }
+
+  // slots must be sorted, as applySprings() hands them out
+  void removeAt(const std::vector<int> &slots)
+  {
+    for (auto k = slots.rbegin(); k != slots.rend(); ++k)
+      removeAt(*k);
+  }
+
+  // removeAt() for every link dropped(link) says: only the dropped pairs
+  // touch the hash, where removeIf() rebuilds it
+  template <class Predicate>
+  void removeEach(Predicate dropped)
+  {
+    for (int k = int(links.size()) - 1; k >= 0; --k)
+      if (dropped(links[k]))
+        removeAt(k);
+  }
+
+  template <class Predicate>
+  void removeIf(Predicate dropped)
+  {
+    links.erase(std::remove_if(links.begin(), links.end(), dropped), links.end());
+    reindex();
+  }
+
+  // the particles were renumbered, i -> to[i]; links to a particle mapped
+  // to -1 are dropped, and so are links whose two ends now are the same
+  // particle or the pair of an earlier link
+  void remap(const std::vector<int> &to)
+  {
+    slot.clear();
+    int n = 0;
+    for (int k = 0; k < links.size(); ++k)
+    {
+      int i = to[links[k].i], j = to[links[k].j];
+      if (i < 0 || j < 0 || i == j || !slot.emplace(key(i, j), n).second)
+        continue;
+      links[n] = links[k];
+      links[n].i = i;
+      links[n].j = j;
+      ++n;
+    }
+    links.resize(n);
+  }
+
+  void compact()
+  {
+    std::sort(links.begin(), links.end(), [](const Link &a, const Link &b) {
+      return key(a.i, a.j) < key(b.i, b.j);
+    });
+    reindex();
+  }
+
+  void clear()
+  {
+    links.clear();
+    slot.clear();
+  }
+
+  int size() const { return links.size(); }
+  const Link &operator[](int k) const { return links[k]; }
+  typename std::vector<Link>::const_iterator begin() const { return links.begin(); }
+  typename std::vector<Link>::const_iterator end() const { return links.end(); }
+
+  // what the force loops take
+  const std::vector<Link> &list() const { return links; }
+
+private:
+  std::vector<Link> links;
+  std::unordered_map<uint64_t, int> slot;
+
+  // lower particle in the high bits, so sorting by key sorts by particle
+  static uint64_t key(int i, int j)
+  {
+    uint32_t lo = std::min(i, j), hi = std::max(i, j);
+    return uint64_t(lo) << 32 | hi;
+  }
+
+  void reindex()
+  {
+    slot.clear();
+    slot.reserve(links.size());
+    for (int k = 0; k < links.size(); ++k)
+      slot[key(links[k].i, links[k].j)] = k;
+  }
+};
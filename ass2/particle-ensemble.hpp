@@ -0,0 +1,247 @@
+#pragma once
+
+// many small copies of the particle.cpp simulation, stepped together
+//
+// a batch holds `lanes` instances that start from the same particles and
+// springs but each have their own timeStep, dragFactor, repulsionFactor,
+// boundarySize and stiffness. the state is interleaved by instance, so
+// x[i * lanes + e] is particle i of instance e: every inner loop runs
+// across the instances of the batch, one instance per SIMD lane, with the
+// same particle and spring indices in every lane. (gcc only makes SIMD
+// instructions of the lanes when sqrt need not set errno: -fno-math-errno,
+// which clang on macOS assumes anyway. without it the lanes run one by one.)
+//
+// the step is springs, boundary, repulsion, drag and integration, with the
+// formulas of particle-sim.hpp; likes, buddies, breaking springs and
+// sleeping are left out.
+
+#include "al/math/al_Vec.hpp"
+#include "particle-sim.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+using namespace al;
+
+struct EnsembleSettings
+{
+  float timeStep, dragFactor, repulsionFactor, boundarySize, stiffness;
+};
+
+// how an instance ended up
+struct EnsembleMetrics
+{
+  float kineticEnergy; // per particle
+  float meanStrain;    // over the springs
+  float radius;        // farthest particle from the origin
+  bool finite;         // no NaN or infinity anywhere
+};
+
+class ParticleBatch
+{
+public:
+  static const int lanes = 8;
+
+  // settings.size() instances (at most lanes); spare lanes repeat the first
+  void setup(const std::vector<Vec3f> &position, const std::vector<Vec3f> &velocity,
+             const std::vector<float> &mass, const std::vector<spring> &springs,
+             const std::vector<EnsembleSettings> &settings)
+  {
+    n = position.size();
+    instances = std::min(int(settings.size()), lanes);
+    links = springs;
+    for (int e = 0; e < lanes; ++e)
+      lane[e] = settings[e < instances ? e : 0];
+
+    for (auto *a : {&x, &y, &z, &vx, &vy, &vz, &fx, &fy, &fz})
+      a->assign(n * lanes, 0);
+    inverseMass.resize(n);
+    for (int i = 0; i < n; ++i)
+    {
+      inverseMass[i] = 1 / mass[i];
+      for (int e = 0; e < lanes; ++e)
+      {
+        int k = i * lanes + e;
+        x[k] = position[i][0];
+        y[k] = position[i][1];
+        z[k] = position[i][2];
+        vx[k] = velocity[i][0];
+        vy[k] = velocity[i][1];
+        vz[k] = velocity[i][2];
+      }
+    }
+  }
+
+  int size() const { return instances; }
+
+  void step()
+  {
+    std::fill(fx.begin(), fx.end(), 0);
+    std::fill(fy.begin(), fy.end(), 0);
+    std::fill(fz.begin(), fz.end(), 0);
+    applySprings();
+    applyBoundary();
+    applyRepulsion();
+    integrate();
+  }
+
+  EnsembleMetrics metrics(int e) const
+  {
+    EnsembleMetrics m{0, 0, 0, true};
+    for (int i = 0; i < n; ++i)
+    {
+      int k = i * lanes + e;
+      m.kineticEnergy += 0.5f / inverseMass[i] * (vx[k] * vx[k] + vy[k] * vy[k] + vz[k] * vz[k]);
+      m.radius = std::max(m.radius, std::sqrt(x[k] * x[k] + y[k] * y[k] + z[k] * z[k]));
+      m.finite = m.finite && std::isfinite(x[k] + y[k] + z[k] + vx[k] + vy[k] + vz[k]);
+    }
+    m.kineticEnergy /= std::max(n, 1);
+    for (auto &s : links)
+    {
+      int i = s.i * lanes + e, j = s.j * lanes + e;
+      float dx = x[j] - x[i], dy = y[j] - y[i], dz = z[j] - z[i];
+      m.meanStrain += std::abs(std::sqrt(dx * dx + dy * dy + dz * dz) - s.length) / std::max(s.length, 1e-6f);
+    }
+    if (!links.empty())
+      m.meanStrain /= links.size();
+    m.finite = m.finite && std::isfinite(m.kineticEnergy) && std::isfinite(m.meanStrain);
+    return m;
+  }
+
+private:
+  int n = 0, instances = 0;
+  EnsembleSettings lane[lanes];
+  std::vector<spring> links; // .stiffness unused: each lane has its own
+  std::vector<float> x, y, z, vx, vy, vz, fx, fy, fz;
+  std::vector<float> inverseMass; // the same in every lane
+
+  // a[e] += b[e] and a[e] -= b[e] across the lanes. kept one array per
+  // loop: a loop that reads positions and writes several force arrays
+  // has to assume they overlap, and runs lane by lane
+  static void add(float *a, const float *b)
+  {
+    for (int e = 0; e < lanes; ++e)
+      a[e] += b[e];
+  }
+  static void subtract(float *a, const float *b)
+  {
+    for (int e = 0; e < lanes; ++e)
+      a[e] -= b[e];
+  }
+
+  void applySprings()
+  {
+    float stiffness[lanes];
+    for (int e = 0; e < lanes; ++e)
+      stiffness[e] = lane[e].stiffness;
+    for (auto &s : links)
+    {
+      int i = s.i * lanes, j = s.j * lanes;
+      float px[lanes], py[lanes], pz[lanes];
+      for (int e = 0; e < lanes; ++e)
+      {
+        float dx = x[j + e] - x[i + e], dy = y[j + e] - y[i + e], dz = z[j + e] - z[i + e];
+        float distance = std::sqrt(dx * dx + dy * dy + dz * dz);
+        float f = stiffness[e] * (distance - s.length) / distance;
+        px[e] = dx * f;
+        py[e] = dy * f;
+        pz[e] = dz * f;
+      }
+      add(&fx[i], px);
+      add(&fy[i], py);
+      add(&fz[i], pz);
+      subtract(&fx[j], px);
+      subtract(&fy[j], py);
+      subtract(&fz[j], pz);
+    }
+  }
+
+  // toward a shell of radius boundarySize around the origin
+  void applyBoundary()
+  {
+    float size[lanes];
+    for (int e = 0; e < lanes; ++e)
+      size[e] = lane[e].boundarySize;
+    for (int i = 0; i < n * lanes; i += lanes)
+    {
+      float px[lanes], py[lanes], pz[lanes];
+      for (int e = 0; e < lanes; ++e)
+      {
+        float distance = std::sqrt(x[i + e] * x[i + e] + y[i + e] * y[i + e] + z[i + e] * z[i + e]);
+        float f = (distance - size[e]) / distance;
+        px[e] = x[i + e] * f;
+        py[e] = y[i + e] * f;
+        pz[e] = z[i + e] * f;
+      }
+      subtract(&fx[i], px);
+      subtract(&fy[i], py);
+      subtract(&fz[i], pz);
+    }
+  }
+
+  // the push on particle a is summed locally and written once per a
+  void applyRepulsion()
+  {
+    float factor[lanes];
+    for (int e = 0; e < lanes; ++e)
+      factor[e] = lane[e].repulsionFactor;
+    for (int a = 0; a < n; ++a)
+    {
+      int i = a * lanes;
+      float sx[lanes] = {}, sy[lanes] = {}, sz[lanes] = {};
+      for (int b = a + 1; b < n; ++b)
+      {
+        int j = b * lanes;
+        float px[lanes], py[lanes], pz[lanes];
+        for (int e = 0; e < lanes; ++e)
+        {
+          float dx = x[i + e] - x[j + e], dy = y[i + e] - y[j + e], dz = z[i + e] - z[j + e];
+          float distSqr = dx * dx + dy * dy + dz * dz;
+          float f = std::min(factor[e] / distSqr, 1.0f) / std::sqrt(distSqr);
+          px[e] = dx * f;
+          py[e] = dy * f;
+          pz[e] = dz * f;
+        }
+        add(sx, px);
+        add(sy, py);
+        add(sz, pz);
+        subtract(&fx[j], px);
+        subtract(&fy[j], py);
+        subtract(&fz[j], pz);
+      }
+      add(&fx[i], sx);
+      add(&fy[i], sy);
+      add(&fz[i], sz);
+    }
+  }
+
+  // drag, then "semi-implicit" Euler
+  void integrate()
+  {
+    float drag[lanes], dt[lanes];
+    for (int e = 0; e < lanes; ++e)
+    {
+      drag[e] = lane[e].dragFactor;
+      dt[e] = lane[e].timeStep;
+    }
+    integrate(x, vx, fx, drag, dt);
+    integrate(y, vy, fy, drag, dt);
+    integrate(z, vz, fz, drag, dt);
+  }
+
+  // one axis
+  void integrate(std::vector<float> &p, std::vector<float> &v, const std::vector<float> &f,
+                 const float *drag, const float *dt)
+  {
+    for (int a = 0; a < n; ++a)
+    {
+      int i = a * lanes;
+      float w = inverseMass[a];
+      for (int e = 0; e < lanes; ++e)
+        v[i + e] += (f[i + e] - v[i + e] * drag[e]) * w * dt[e];
+      for (int e = 0; e < lanes; ++e)
+        p[i + e] += v[i + e] * dt[e];
+    }
+  }
+};
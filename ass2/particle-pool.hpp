@@ -0,0 +1,172 @@
+#pragma once
+
+// which particle is which while particles come and go
+//
+// the particle arrays stay dense (the force loops and the links use plain
+// indices), and the pool keeps a slot per particle that does not move:
+// spawn() hands out a handle {slot, generation}, kill() bumps the slot's
+// generation so every old handle to it reads as dead at once. the dead
+// particle itself stays in the arrays until compact(), which closes the
+// gaps in one pass (keeping the order) and returns the old -> new index
+// map for the arrays and the link lists; only then are the slots reused.
+
+#include <cstdint>
+#include <vector>
+
+struct ParticleHandle
+{
+  uint32_t slot = 0, generation = 0;
+};
+
+class ParticlePool
+{
+public:
+  // room for this many particles before anything reallocates
+  void reserve(int capacity)
+  {
+    generation.reserve(capacity);
+    denseOf.reserve(capacity);
+    slotOf.reserve(capacity);
+    freeSlots.reserve(capacity);
+    dying.reserve(capacity);
+    remap.reserve(capacity);
+  }
+
+  // the new particle goes at index size() - 1
+  ParticleHandle spawn()
+  {
+    uint32_t slot;
+    if (freeSlots.empty())
+    {
+      slot = generation.size();
+      generation.push_back(0);
+      denseOf.push_back(-1);
+    }
+    else
+    {
+      slot = freeSlots.back();
+      freeSlots.pop_back();
+    }
+    denseOf[slot] = slotOf.size();
+    slotOf.push_back(slot);
+    return {slot, generation[slot]};
+  }
+
+  // false if it was dead already; the index stays taken until compact()
+  bool kill(ParticleHandle h)
+  {
+    if (!alive(h))
+      return false;
+    ++generation[h.slot];
+    dying.push_back(denseOf[h.slot]);
+    return true;
+  }
+
+  bool alive(ParticleHandle h) const
+  {
+    return h.slot < generation.size() && generation[h.slot] == h.generation;
+  }
+
+  // index into the particle arrays, -1 if dead
+  int index(ParticleHandle h) const { return alive(h) ? denseOf[h.slot] : -1; }
+
+  ParticleHandle handle(int index) const
+  {
+    uint32_t slot = slotOf[index];
+    return {slot, generation[slot]};
+  }
+
+  int size() const { return slotOf.size(); } // killed ones included until compact()
+  int killed() const { return dying.size(); }
+  int live() const { return size() - killed(); }
+  const std::vector<int> &killedIndices() const { return dying; }
+
+  // old index -> new index, -1 for the killed
+  const std::vector<int> &compact()
+  {
+    remap.assign(slotOf.size(), 0);
+    for (int i : dying)
+      remap[i] = -1;
+    int n = 0;
+    for (int i = 0; i < slotOf.size(); ++i)
+    {
+      uint32_t slot = slotOf[i];
+      if (remap[i] < 0)
+      {
+        denseOf[slot] = -1;
+        freeSlots.push_back(slot);
+        continue;
+      }
+      remap[i] = n;
+      slotOf[n] = slot;
+      denseOf[slot] = n;
+      ++n;
+    }
+    slotOf.resize(n);
+    dying.clear();
+    return remap;
+  }
+
+private:
+  std::vector<uint32_t> generation; // per slot
+  std::vector<int> denseOf;         // slot -> index
+  std::vector<uint32_t> slotOf;     // index -> slot
+  std::vector<uint32_t> freeSlots;
+  std::vector<int> dying; // indices killed since the last compact()
+  std::vector<int> remap;
+};
+
+// handles in the order they were spawned, oldest first: a ring over room
+// reserved up front, which only grows if pushed past it
+class SpawnOrder
+{
+public:
+  void reserve(int capacity)
+  {
+    if (capacity > int(ring.size()))
+      grow(capacity);
+  }
+
+  bool empty() const { return count == 0; }
+  int size() const { return count; }
+
+  void push(ParticleHandle h)
+  {
+    if (count == int(ring.size()))
+      grow(count < 8 ? 16 : 2 * count);
+    ring[(head + count) % ring.size()] = h;
+    ++count;
+  }
+
+  ParticleHandle pop()
+  {
+    ParticleHandle h = ring[head];
+    head = (head + 1) % ring.size();
+    --count;
+    return h;
+  }
+
+private:
+  void grow(int capacity)
+  {
+    std::vector<ParticleHandle> bigger(capacity);
+    for (int k = 0; k < count; ++k)
+      bigger[k] = ring[(head + k) % ring.size()];
+    ring.swap(bigger);
+    head = 0;
+  }
+
+  std::vector<ParticleHandle> ring;
+  int head = 0, count = 0;
+};
+
+// applies a ParticlePool::compact() map to one of the particle arrays
+template <class T>
+void compactArray(std::vector<T> &array, const std::vector<int> &remap)
+{
+  int n = 0;
+  for (int i = 0; i < remap.size(); ++i)
+    if (remap[i] >= 0)
+      array[n++] = array[i];
+  array.resize(n);
+}
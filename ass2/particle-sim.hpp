@@ -0,0 +1,215 @@
+#pragma once
+
+// the force and integration passes of particle.cpp as free functions over
+// plain arrays, so they can also run outside the app (see bench/)
+
+#include "al/math/al_Vec.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+using namespace al;
+
+class like
+{
+public:
+  int i, j; // string names serves to refer to them //i and j r two particles
+
+  float energy;
+};
+
+
+class buddy
+{
+  public:
+  int i, j;
+
+  float vibes;
+
+};
+
+
+class spring
+{
+public:
+  int i, j; // string names serves to refer to them //i and j r two particles
+
+  float length;    // resting length
+  float stiffness; // resting stiffness
+};
+
+// strain: |change in length| / rest length, summed by applySprings() so
+// what the audio hears (see onSound in particle.cpp) needs no pass of its own
+inline float strainOf(const spring &s, float distance)
+{
+  return std::abs(distance - s.length) / std::max(s.length, 1e-6f);
+}
+
+// compute spring force; returns the summed strain
+inline float applySprings(const std::vector<Vec3f> &position, const std::vector<spring> &spring_list,
+                          std::vector<Vec3f> &force)
+{
+  float strain = 0;
+  for (int k = 0; k < spring_list.size(); ++k)
+  {
+    auto spring = spring_list[k];
+    // positions of the particle pair...
+    Vec3f a = position[spring.i];
+    Vec3f b = position[spring.j];
+    Vec3f displacement = b - a;
+    float distance = displacement.mag();
+    Vec3f f = displacement.normalize() * spring.stiffness * (distance - spring.length); // if u have a normalization it sets the length to one
+    force[spring.i] += f;
+    force[spring.j] -= f;
+    strain += strainOf(spring, distance);
+  }
+  return strain;
+}
+
+// the same, but a spring stretched or squashed past maxStrain (change in
+// length over rest length) snaps: it pushes nothing and its slot is
+// appended to broken, in increasing order. the summed strain is of the
+// springs that held
+inline float applySprings(const std::vector<Vec3f> &position, const std::vector<spring> &spring_list,
+                          std::vector<Vec3f> &force, float maxStrain, std::vector<int> &broken)
+{
+  float strain = 0;
+  for (int k = 0; k < spring_list.size(); ++k)
+  {
+    auto spring = spring_list[k];
+    Vec3f displacement = position[spring.j] - position[spring.i];
+    float distance = displacement.mag();
+    float stretch = distance - spring.length;
+    if (std::abs(stretch) > maxStrain * spring.length)
+    {
+      broken.push_back(k);
+      continue;
+    }
+    Vec3f f = displacement.normalize() * spring.stiffness * stretch;
+    force[spring.i] += f;
+    force[spring.j] -= f;
+    strain += strainOf(spring, distance);
+  }
+  return strain;
+}
+
+// pull every particle toward a shell of radius boundarySize around the origin
+inline void applyBoundary(const std::vector<Vec3f> &position, float boundarySize, std::vector<Vec3f> &force)
+{
+  for (int k = 0; k < position.size(); ++k)
+  {
+    Vec3f a = position[k]; // make b the origin
+    Vec3f b = Vec3f(0,0,0);
+    Vec3f displacement = b - a;
+    float distance = displacement.mag();
+    Vec3f f = displacement.normalize() * (distance - boundarySize);
+    force[k] += f;
+  }
+}
+
+inline void applyLikes(const std::vector<Vec3f> &position, const std::vector<like> &like_list,
+                       std::vector<Vec3f> &force)
+{
+  for (int k = 0; k < like_list.size(); ++k)
+  {
+    auto like = like_list[k];
+    // positions of the particle pair...
+    Vec3f a = position[like.i]; // hw is building springs between a and the origin not b
+    Vec3f b = position[like.j];
+    Vec3f displacement = b - a;
+    Vec3f f = displacement.normalize() * like.energy; //
+    force[like.i] += f;
+    force[like.j] += f; // make them both same so that theyre asymettrical
+  }
+}
+
+inline void applyBuddies(const std::vector<Vec3f> &position, const std::vector<buddy> &buddy_list,
+                         std::vector<Vec3f> &force)
+{
+  for (int k = 0; k < buddy_list.size(); ++k)
+  {
+    auto buddy = buddy_list[k];
+    // positions of the particle pair...
+    Vec3f a = position[buddy.i]; //
+    Vec3f b = Vec3f(0,0,0);
+    Vec3f displacement = b - a;
+    Vec3f f = displacement.normalize() * buddy.vibes; //
+    force[buddy.i] += f;
+    force[buddy.j] += f; // make them both same so that theyre asymettrical
+  }
+}
+
+// the repulsion applyRepulsion() puts on a from b (b gets the opposite)
+inline Vec3f repulsionBetween(Vec3f a, Vec3f b, float repulsionFactor)
+{
+  Vec3f displacement = a - b;
+  float forceUnit = std::min(repulsionFactor / displacement.magSqr(), 1.0f);
+  return displacement.normalize() * forceUnit;
+}
+
+// repulsion (culombs law)
+inline void applyRepulsion(const std::vector<Vec3f> &position, float repulsionFactor, std::vector<Vec3f> &force)
+{
+  for (int i = 0; i < position.size(); ++i)
+  {
+    for (int j = i + 1; j < position.size(); ++j)
+    {
+      if (i == j) continue;
+
+      Vec3f a = position[i];
+      Vec3f b = position[j];
+      Vec3f displacement = a - b;
+
+      float distSqr = displacement.magSqr(); // alternatively float distance = displacement.mag(); --> (distance * distance);
+      float forceUnit = repulsionFactor / distSqr;
+      forceUnit = std::min(forceUnit, 1.0f); // add a boundary to limit the maximum strength
+
+
+      Vec3f direction = displacement.normalize();
+      Vec3f f = direction * forceUnit;
+      force[i] += f;
+      force[j] -= f;
+
+      // i and j are a pair
+      // apply and equal and possible force
+      // as they get futher apart they influence each other much less
+      // as they get close to each other they influence each other a lot more
+
+      // limit large forces... if the force is too large, ignore it // they should slide thru each other
+    }
+  }
+}
+
+// drag
+inline void applyDrag(const std::vector<Vec3f> &velocity, float dragFactor, std::vector<Vec3f> &force)
+{
+  for (int i = 0; i < velocity.size(); i++)
+  {
+    force[i] += -velocity[i] * dragFactor;
+  }
+}
+
+// Integration
+//
+// returns the kinetic energy after the step, the sum of 1/2 m v^2
+inline float integrate(std::vector<Vec3f> &position, std::vector<Vec3f> &velocity,
+                       const std::vector<Vec3f> &force, const std::vector<float> &mass, float timeStep)
+{
+  float energy = 0;
+  for (int i = 0; i < velocity.size(); i++)
+  {
+    // "semi-implicit" Euler integration
+    velocity[i] += force[i] / mass[i] * timeStep;
+    position[i] += velocity[i] * timeStep;
+    energy += 0.5f * mass[i] * velocity[i].magSqr();
+  }
+  return energy;
+}
+
+// clear all accelerations (IMPORTANT!!)
+inline void clearForces(std::vector<Vec3f> &force)
+{
+  for (auto &a : force)
+    a.set(0);
+}
@@ -0,0 +1,238 @@
+#pragma once
+
+// once the cloud settles most particles hardly move, but every step still
+// pays for all of them. a particle that has been slow and nearly force-free
+// for calmSteps steps is calm; particles joined by springs, likes or
+// buddies form an island, and an island falls asleep when all of it is
+// calm and wakes as a whole when any member is pushed harder than
+// wakeForce.
+//
+// sleepers are not integrated. they do not move, so the repulsion between
+// two sleepers does not change: it is summed once when the set of sleepers
+// changes and added back from the cache, and the O(n*n) pass only visits
+// pairs with an awake particle in them.
+//
+// only the repulsion and integrate() skip sleepers. the springs, likes,
+// buddies, boundary and drag still visit every particle and link each
+// step: they are linear, small next to the repulsion, and a sleeper's force
+// has to include them for wakeForce to compare against the right total.
+
+#include "al/math/al_Vec.hpp"
+#include "particle-sim.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <numeric>
+#include <vector>
+
+using namespace al;
+
+class ParticleSleep
+{
+public:
+  float sleepSpeed = 0.005f; // calm: slower than this ...
+  float sleepForce = 0.01f;  // ... with less net force than this ...
+  int calmSteps = 30;        // ... for this many steps
+  float wakeForce = 0.05f;
+
+  // everyone awake, e.g. after particles were added or removed
+  void resize(int n)
+  {
+    asleep.assign(n, 0);
+    calm.assign(n, 0);
+    cache.assign(n, Vec3f(0));
+    cached = false;
+    awake.resize(n);
+    std::iota(awake.begin(), awake.end(), 0);
+  }
+
+  void wakeAll() { resize(asleep.size()); }
+
+  // a new particle at index size(), awake; the sleepers stay asleep
+  void add()
+  {
+    awake.push_back(asleep.size());
+    asleep.push_back(0);
+    calm.push_back(0);
+    cache.push_back(Vec3f(0));
+  }
+
+  // one particle awake on its own, e.g. before it is moved by hand
+  void wake(int i)
+  {
+    calm[i] = 0;
+    if (!asleep[i])
+      return;
+    asleep[i] = 0;
+    cached = false;
+    awake.insert(std::lower_bound(awake.begin(), awake.end(), i), i);
+  }
+
+  // the particles were renumbered, i -> to[i] (-1: gone), as by
+  // ParticlePool::compact(); the rest keep their state
+  void remap(const std::vector<int> &to)
+  {
+    int n = 0;
+    for (int i = 0; i < to.size(); ++i)
+    {
+      if (to[i] < 0)
+      {
+        // the cached sums include what a gone sleeper pushed
+        cached = cached && !asleep[i];
+        continue;
+      }
+      asleep[n] = asleep[i];
+      calm[n] = calm[i];
+      cache[n] = cache[i];
+      ++n;
+    }
+    asleep.resize(n);
+    calm.resize(n);
+    cache.resize(n);
+    awake.clear();
+    for (int i = 0; i < n; ++i)
+      if (!asleep[i])
+        awake.push_back(i);
+  }
+
+  bool sleeping(int i) const { return asleep[i]; }
+  int sleepers() const { return asleep.size() - awake.size(); }
+  const std::vector<int> &awakeParticles() const { return awake; }
+
+  // after this step's forces, before integrate(); links are the spring,
+  // like and buddy lists, anything with .i and .j
+  template <class... Links>
+  void update(std::vector<Vec3f> &velocity, const std::vector<Vec3f> &force, const Links &...links)
+  {
+    int n = asleep.size();
+    woken.assign(n, 0);
+    for (int i = 0; i < n; ++i)
+    {
+      if (asleep[i])
+        woken[i] = force[i].magSqr() > wakeForce * wakeForce;
+      else if (velocity[i].magSqr() < sleepSpeed * sleepSpeed && force[i].magSqr() < sleepForce * sleepForce)
+        ++calm[i];
+      else
+        calm[i] = 0;
+    }
+
+    // islands: union-find over every link
+    parent.resize(n);
+    std::iota(parent.begin(), parent.end(), 0);
+    int unused[] = {(join(links), 0)...};
+    (void)unused;
+
+    // an island sleeps if all of it is calm, and wakes if any of it was pushed
+    allCalm.assign(n, 1);
+    anyWoken.assign(n, 0);
+    for (int i = 0; i < n; ++i)
+    {
+      int r = root(i);
+      allCalm[r] &= calm[i] >= calmSteps || asleep[i];
+      anyWoken[r] |= woken[i];
+    }
+
+    bool changed = false;
+    for (int i = 0; i < n; ++i)
+    {
+      int r = root(i);
+      uint8_t next = anyWoken[r] ? 0 : allCalm[r] ? 1 : asleep[i];
+      if (next == asleep[i])
+        continue;
+      changed = true;
+      asleep[i] = next;
+      calm[i] = 0;
+      velocity[i].set(0);
+    }
+
+    if (changed)
+    {
+      cached = false;
+      awake.clear();
+      for (int i = 0; i < n; ++i)
+        if (!asleep[i])
+          awake.push_back(i);
+    }
+  }
+
+  // applyRepulsion() for the pairs with an awake particle in them, plus the
+  // cached sleeper-sleeper sums
+  void applyRepulsion(const std::vector<Vec3f> &position, float repulsionFactor, std::vector<Vec3f> &force)
+  {
+    int n = position.size();
+    if (!cached || cachedFactor != repulsionFactor)
+    {
+      for (int i = 0; i < n; ++i)
+        cache[i].set(0);
+      for (int i = 0; i < n; ++i)
+        if (asleep[i])
+          for (int j = i + 1; j < n; ++j)
+            if (asleep[j])
+            {
+              Vec3f f = repulsionBetween(position[i], position[j], repulsionFactor);
+              cache[i] += f;
+              cache[j] -= f;
+            }
+      cached = true;
+      cachedFactor = repulsionFactor;
+    }
+
+    for (int i : awake)
+      for (int j = 0; j < n; ++j)
+      {
+        // awake pairs once, from the lower index
+        if (j == i || (!asleep[j] && j < i))
+          continue;
+        Vec3f f = repulsionBetween(position[i], position[j], repulsionFactor);
+        force[i] += f;
+        force[j] -= f;
+      }
+
+    for (int i = 0; i < n; ++i)
+      if (asleep[i])
+        force[i] += cache[i];
+  }
+
+  // integrate() for the awake particles only; sleepers are still, so the
+  // kinetic energy it returns is everyone's
+  float integrate(std::vector<Vec3f> &position, std::vector<Vec3f> &velocity,
+                  const std::vector<Vec3f> &force, const std::vector<float> &mass, float timeStep) const
+  {
+    float energy = 0;
+    for (int i : awake)
+    {
+      velocity[i] += force[i] / mass[i] * timeStep;
+      position[i] += velocity[i] * timeStep;
+      energy += 0.5f * mass[i] * velocity[i].magSqr();
+    }
+    return energy;
+  }
+
+private:
+  std::vector<uint8_t> asleep;
+  std::vector<int> calm; // steps in a row this particle was calm
+  std::vector<int> awake;
+  std::vector<int> parent;
+  std::vector<uint8_t> woken, allCalm, anyWoken; // per particle, and per island root
+  std::vector<Vec3f> cache; // repulsion from the other sleepers
+  bool cached = false;
+  float cachedFactor = 0;
+
+  int root(int i)
+  {
+    while (parent[i] != i)
+      i = parent[i] = parent[parent[i]];
+    return i;
+  }
+
+  template <class Links>
+  void join(const Links &links)
+  {
+    for (auto &link : links)
+    {
+      int a = root(link.i), b = root(link.j);
+      if (a != b)
+        parent[a] = b;
+    }
+  }
+};
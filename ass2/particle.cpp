@@ -4,10 +4,24 @@
 #include "al/app/al_App.hpp"
 #include "al/app/al_GUIDomain.hpp"
 #include "al/math/al_Random.hpp"
+#include "../asset-loader.hpp"
+#include "../feature-stream.hpp"
+#include "../frame-arena.hpp"
+#include "../frame-budget.hpp"
+#include "../mesh-uploads.hpp"
+#include "../scenario.hpp"
+#include "../state-link.hpp"
+#include "../task-graph.hpp"
+#include "../trajectory.hpp"
+#include "edge-set.hpp"
+#include "particle-pool.hpp"
+#include "particle-sim.hpp"
+#include "particle-sleep.hpp"
+#include "spring-network.hpp"
 
 using namespace al;
 
-#include <fstream>
+#include <random>
 #include <vector>
 using namespace std;
 
@@ -15,35 +29,6 @@ Vec3f randomVec3f(float scale)
 {
   return Vec3f(rnd::uniformS(), rnd::uniformS(), rnd::uniformS()) * scale;
 }
-string slurp(string fileName); // forward declaration
-
-class like
-{
-public:
-  int i, j; // string names serves to refer to them //i and j r two particles
-
-  float energy;
-};
-
-
-class buddy 
-{
-  public:
-  int i, j; 
-
-  float vibes;
-
-};
-
-
-class spring
-{
-public:
-  int i, j; // string names serves to refer to them //i and j r two particles
-
-  float length;    // resting length
-  float stiffness; // resting stiffness
-};
 
 struct AlloApp : App
 {
@@ -53,20 +38,101 @@ struct AlloApp : App
   Parameter repulsionFactor{"/repulsionFactor", "", 0.1, 0.0, 10.9};
   Parameter boundarySize{"/boundSize", "", 1.0, 0.0, 10.9};
   Parameter stiffness{"/stifnessfactor", "", 1.0, 0.0, 10.9};
+  ParameterInt particleCount{"/particleCount", "", 1000, 100, 20000};
+  ParameterInt neighbours{"/neighbours", "", 6, 1, 32};       // '5' springs to this many nearest
+  Parameter linkRadius{"/linkRadius", "", 0.5, 0.01, 5.0};    // '6' springs to all within this
+  Parameter breakStrain{"/breakStrain", "", 0.0, 0.0, 5.0};    // 0: springs never break
+  ParameterBool sleeping{"/sleeping", "", 1.0};                 // settled islands skip the work
+  ParameterBool taskGraph{"/taskGraph", "", 1.0};               // step on every core
+  ParameterInt emitRate{"/emitRate", "", 0, 0, 50};             // oldest particles replaced per step
+
+  // adaptive quality: grows or shrinks particleCount to fit the frame budget
+  FrameBudget frameBudget;
+
+  // the spring lines are rebuilt every frame into a reused mesh
+  FrameArena frameArena;
+
+  // 'r' records the particle positions to particles.traj, 'p' plays it back
+  TrajectoryRecorder recorder;
+  TrajectoryPlayer player;
+  bool playing = false;
+  int playFrame = 0;
+
+  // 'c' starts over from a new seed and captures the GUI settings and every
+  // key to particles.scenario until pressed again; "./particle replay
+  // particles.scenario" runs it again without a window
+  ScenarioRecorder capture;
+
+  // "serve": simulate and send every frame to the renderers on port 9010
+  // "render": simulate nothing, draw what the server sends
+  string mode;
+  StateServer server;
+  StateClient client;
   
   //
 
+  AssetLoader assets;
   ShaderProgram pointShader;
 
   //  simulation state
-  Mesh mesh; // position *is inside the mesh* mesh.vertices() are the positions
+  VAOMesh mesh; // position *is inside the mesh* mesh.vertices() are the positions
+  MeshUploads uploads; // positions change every step, colours and sizes only on resize
   vector<Vec3f> velocity;
   vector<Vec3f> force;
   vector<float> mass;
 
-  std::vector<spring> spring_list; // need to make it a member // vector holds a bunch of spring lists
-  std::vector<like> like_list;
-  std::vector<buddy> buddy_list;
+  // each pair linked at most once; links can be removed
+  EdgeSet<spring> spring_list; // need to make it a member // vector holds a bunch of spring lists
+  EdgeSet<like> like_list;
+  EdgeSet<buddy> buddy_list;
+  vector<int> broken;
+  ParticleSleep sleep;
+
+  // particles come and go: a killed one is parked (out of the cloud, held
+  // still, drawn at size 0, its links dropped) and stays in the arrays until
+  // there is one killed for every compactEvery live ones, then they are
+  // squeezed out together; byAge holds handles, oldest first, and skips the
+  // ones that died some other way
+  ParticlePool pool;
+  SpawnOrder byAge;
+  vector<int> killedNow;
+  vector<uint8_t> parking;
+  static const int compactEvery = 8;
+
+  // while this is false, killed < live / compactEvery, which is what
+  // setupSimulation reserves for
+  bool compactionDue() const { return pool.killed() * compactEvery >= pool.live(); }
+
+  // the step as a task graph; 't' saves where the next step's tasks ran
+  // to step-trace.json
+  struct StepParams
+  {
+    float timeStep, dragFactor, repulsionFactor, boundarySize, breakStrain;
+    bool sleeping;
+  };
+  StepParams params, nextParams; // the GUI values this step and the next one use
+  TaskGraph stepGraph;
+  TaskScheduler scheduler;
+  bool traceNextStep = false;
+  vector<Vec3f> springForce, boundaryForce, likeForce, buddyForce, repulsionForce, dragForce;
+  vector<Vec3f> springLines;
+  bool linesFresh = false; // springLines match this frame
+
+  // what the audio hears: summed by the spring and integration loops of each
+  // step as they go, and queued for onSound, which only ever sees these few
+  // numbers
+  struct StepFeatures
+  {
+    float energy = 0; // kinetic, per particle
+    float strain = 0; // mean over the springs
+  };
+  StepFeatures measured;
+  FeatureStream<StepFeatures> features;
+
+  // audio thread only
+  StepFeatures heard;
+  Smoothed pitch, loudness;
+  double phase = 0;
 
   void onInit() override
   {
@@ -79,141 +145,330 @@ struct AlloApp : App
     gui.add(repulsionFactor); // add parameter to GUI
     gui.add(boundarySize); // add parameter to GUI
     gui.add(stiffness); // add parameter to GUI
+    gui.add(particleCount);
+    gui.add(neighbours);
+    gui.add(linkRadius);
+    gui.add(breakStrain);
+    gui.add(sleeping);
+    gui.add(taskGraph);
+    gui.add(emitRate);
+    gui.add(frameBudget.budget);
+    gui.add(frameBudget.measured);
+    gui.add(frameBudget.adaptive);
+    gui.add(frameArena.allocations);
     //
+
+    // read the shaders while the window opens
+    for (auto path : {"../point-vertex.glsl", "../point-fragment.glsl", "../point-geometry.glsl"})
+    {
+      assets.prefetch(path);
+      assets.watch(path);
+    }
+  }
+
+  void compileShader()
+  {
+    assets.compile(pointShader, "../point-vertex.glsl", "../point-fragment.glsl",
+                   "../point-geometry.glsl");
   }
 
   void onCreate() override
   {
     // compile shaders
-    pointShader.compile(slurp("../point-vertex.glsl"),
-                        slurp("../point-fragment.glsl"),
-                        slurp("../point-geometry.glsl"));
+    compileShader();
+    setupSimulation();
+  }
 
-    // set initial conditions of the simulation
-    //
+  // set initial conditions of the simulation
+  //
+  void setupSimulation()
+  {
+    mesh.primitive(Mesh::POINTS);
+    // room for the most particles the GUI allows, the killed ones waiting
+    // for compaction (fewer than max / compactEvery, see compactionDue) and
+    // a step's worth of new ones before the next check, so spawning never
+    // reallocates
+    int capacity = particleCount.max() + particleCount.max() / compactEvery + emitRate.max();
+    pool.reserve(capacity);
+    byAge.reserve(capacity);
+    mesh.vertices().reserve(capacity);
+    mesh.colors().reserve(capacity);
+    mesh.texCoord2s().reserve(capacity);
+    velocity.reserve(capacity);
+    force.reserve(capacity);
+    mass.reserve(capacity);
+    // does 1000 work on your system? how many can you make before you get a low
+    // frame rate? do you need to use <1000? (frameBudget answers this now)
+    resizeParticles(particleCount.get());
+    nextParams = snapshotParams();
+    buildStepGraph();
+
+    if (mode == "serve")
+      server.open(9010, Vec3f(-20), Vec3f(20));
+    if (mode == "render")
+      client.open("127.0.0.1", 9010);
+
+    nav().pos(0, 0, 10);
+  }
+
+  // as if just started, with rnd seeded; the frame budget stops adapting
+  // so that particleCount only changes when the scenario says so
+  void restart(uint32_t seed)
+  {
+    rnd::global().seed(seed);
+    frameBudget.adaptive.set(false);
+    spring_list.clear();
+    like_list.clear();
+    buddy_list.clear();
+    resizeParticles(0);
+    resizeParticles(particleCount.get());
+    nextParams = snapshotParams();
+    freeze = false;
+    playing = false;
+  }
+
+  // every GUI value the step depends on
+  void settings(Scenario &s, bool apply)
+  {
+    s.setting(timeStep, apply);
+    s.setting(dragFactor, apply);
+    s.setting(repulsionFactor, apply);
+    s.setting(boundarySize, apply);
+    s.setting(stiffness, apply);
+    s.setting(particleCount, apply);
+    s.setting(neighbours, apply);
+    s.setting(linkRadius, apply);
+    s.setting(breakStrain, apply);
+    s.setting(sleeping, apply);
+    s.setting(taskGraph, apply);
+    s.setting(emitRate, apply);
+  }
 
+  bool replay(const string &path)
+  {
+    Scenario s;
+    if (!s.load(path))
+      return false;
+    settings(s, true);
+    setupSimulation();
+    restart(s.seed);
+    ScenarioReport report = replayScenario(*this, s, [&]()
+                                           { return stateChecksum(); });
+    report.print(cout, s.step);
+    report.writeTiming(path + ".timing.csv");
+    return true;
+  }
+
+  // what a replay prints, and capturing prints when it ends
+  uint64_t stateChecksum() { return checksum(velocity, checksum(mesh.vertices())); }
+
+  void addParticle()
+  {
     // c++11 "lambda" function
     auto randomColor = []()
     { return HSV(rnd::uniform(0.50, 0.70), rnd::uniform(), rnd::uniform()); };
 
-    mesh.primitive(Mesh::POINTS);
-    // does 1000 work on your system? how many can you make before you get a low
-    // frame rate? do you need to use <1000?
-    for (int _ = 0; _ < 1000; _++)
-    {
-      mesh.vertex(randomVec3f(5));
-      mesh.color(randomColor());
+    mesh.vertex(randomVec3f(5));
+    mesh.color(randomColor());
 
-      // float m = rnd::uniform(3.0, 0.5);
-      float m = 3 + rnd::normal() / 2;
-      if (m < 0.5)
-        m = 0.5;
-      mass.push_back(m);
+    // float m = rnd::uniform(3.0, 0.5);
+    float m = 3 + rnd::normal() / 2;
+    if (m < 0.5)
+      m = 0.5;
+    mass.push_back(m);
 
-      // using a simplified volume/size relationship
-      mesh.texCoord(pow(m, 1.0f / 3), 0); // s, t
+    // using a simplified volume/size relationship
+    mesh.texCoord(pow(m, 1.0f / 3), 0); // s, t
 
-      // separate state arrays
-      velocity.push_back(randomVec3f(0.1));
-      force.push_back(randomVec3f(1));
-    }
+    // separate state arrays
+    velocity.push_back(randomVec3f(0.1));
+    force.push_back(randomVec3f(1));
 
-    nav().pos(0, 0, 10);
+    byAge.push(pool.spawn());
+    sleep.add();
   }
 
-  bool freeze = false;
-  void onAnimate(double dt) override
+  // the index of the particle killed, -1 if none was left
+  int killOldest()
   {
-    if (freeze)
-      return;
-
-    // compute spring force
+    while (!byAge.empty())
+    {
+      ParticleHandle h = byAge.pop();
+      int i = pool.index(h);
+      if (pool.kill(h))
+        return i;
+    }
+    return -1;
+  }
 
-    for (int k = 0; k < spring_list.size(); ++k)
+  // takes killed particles out of the step until the next compaction: far
+  // from the cloud (and from each other), still, invisible and unlinked
+  void parkParticles(const vector<int> &killed)
+  {
+    if (killed.empty())
+      return;
+    parking.assign(pool.size(), 0);
+    for (int i : killed)
     {
-      auto spring = spring_list[k];
-      // positions of the particle pair...
-      Vec3f a = mesh.vertices()[spring.i]; 
-      Vec3f b = mesh.vertices()[spring.j];
-      Vec3f displacement = b - a;
-      float distance = displacement.mag();
-      Vec3f f = displacement.normalize() * spring.stiffness * (distance - spring.length); // if u have a normalization it sets the length to one
-      force[spring.i] += f;
-      force[spring.j] -= f;
+      parking[i] = 1;
+      sleep.wake(i);
+      mesh.vertices()[i] = Vec3f(0, 0, 1e4f + i);
+      mesh.texCoord2s()[i] = Vec2f(0);
+      velocity[i].set(0);
+      uploads.mark(MeshUploads::TexCoords, i, i + 1);
     }
+    auto parked = [&](const auto &link)
+    { return parking[link.i] || parking[link.j]; };
+    spring_list.removeEach(parked);
+    like_list.removeEach(parked);
+    buddy_list.removeEach(parked);
+    linesFresh = false;
+  }
 
+  // no force moves a parked particle
+  void holdParked()
+  {
+    for (int i : pool.killedIndices())
+      force[i].set(0);
+  }
 
-    for (int k = 0; k < mesh.vertices().size(); ++k)
-    {
+  // closes the gaps the killed particles left, and drops their links
+  void compactParticles()
+  {
+    if (pool.killed() == 0)
+      return;
+    const vector<int> &to = pool.compact();
+    compactArray(mesh.vertices(), to);
+    compactArray(mesh.colors(), to);
+    compactArray(mesh.texCoord2s(), to);
+    compactArray(velocity, to);
+    compactArray(force, to);
+    compactArray(mass, to);
+    spring_list.remap(to);
+    like_list.remap(to);
+    buddy_list.remap(to);
+    sleep.remap(to);
+    uploads.markAll(); // everything behind the first gap moved
+  }
 
-     // float bound = floor(rnd::uniform(5.0f, 10.0f));
-      Vec3f a = mesh.vertices()[k]; // make b the origin 
-      Vec3f b = Vec3f(0,0,0);
-      Vec3f displacement = b - a;
-      float distance = displacement.mag();
-      Vec3f f = displacement.normalize() * (distance - boundarySize); 
-      force[k] += f;
-    }
+  // adds new random particles, or drops the oldest ones and every link to them
+  void resizeParticles(int n)
+  {
+    while (pool.live() < n)
+      addParticle();
+    while (pool.live() > n)
+      killOldest();
+    compactParticles();
+    sleep.wakeAll();
+  }
 
-    for (int k = 0; k < like_list.size(); ++k)
-    {
-      auto like = like_list[k];
-      // positions of the particle pair...
-      Vec3f a = mesh.vertices()[like.i]; // hw is building springs between a and the origin not b
-      Vec3f b = mesh.vertices()[like.j];
-      Vec3f displacement = b - a;
-      Vec3f f = displacement.normalize() * like.energy; //
-      force[like.i] += f;
-      force[like.j] += f; // make them both same so that theyre asymettrical
-    }
+  bool freeze = false;
+  void onAnimate(double dt) override
+  {
+    frameBudget.start();
+    dt = capture.advance(dt); // the scenario's fixed step while capturing
 
+    // edited shaders are picked up without restarting
+    if (!assets.changed().empty())
+      compileShader();
+    linesFresh = false;
 
-    for (int k = 0; k < buddy_list.size(); ++k)
+    if (mode == "render")
     {
-      auto buddy = buddy_list[k];
-      // positions of the particle pair...
-      Vec3f a = mesh.vertices()[buddy.i]; //
-      Vec3f b = Vec3f(0,0,0);
-      Vec3f displacement = b - a;
-      Vec3f f = displacement.normalize() * buddy.vibes; //
-      force[buddy.i] += f;
-      force[buddy.j] += f; // make them both same so that theyre asymettrical
+      WorldState state;
+      if (client.receive(state))
+      {
+        if (state.positions.size() != mesh.vertices().size())
+          resizeParticles(state.positions.size());
+        mesh.vertices() = state.positions;
+        mesh.colors() = state.colors;
+        uploads.mark(MeshUploads::Positions);
+        uploads.mark(MeshUploads::Colors);
+      }
+      return;
     }
 
+    if (playing)
+    {
+      vector<Quatf> unused;
+      vector<Vec3f> positions;
+      player.frame(playFrame, positions, unused);
+      playFrame = (playFrame + 1) % player.frames();
+      if (positions.size() != mesh.vertices().size())
+        resizeParticles(positions.size());
+      mesh.vertices() = positions;
+      uploads.mark(MeshUploads::Positions);
+      return;
+    }
 
-    // Calculate forces
-
+    if (freeze)
+      return;
 
-    // repulsion (culombs law)
-    for (int i = 0; i < mesh.vertices().size(); ++i)
+    // over budget: drop a fifth of the particles; room to spare: add a tenth
+    int step = frameBudget.decide();
+    if (step < 0)
+      particleCount.set(max(100, int(particleCount.get() * 0.8f)));
+    if (step > 0)
+      particleCount.set(min(20000, int(particleCount.get() * 1.1f)));
+    if (particleCount.get() != pool.live())
+      resizeParticles(particleCount.get());
+
+    // a steady stream: the oldest particles leave, as many new ones arrive.
+    // the renderers and the recording see the arrays as they are, so for
+    // them the killed go at once
+    killedNow.clear();
+    for (int k = 0; k < emitRate.get() && k < pool.size(); ++k)
     {
-      for (int j = i + 1; j < mesh.vertices().size(); ++j)
-      {
-        if (i == j) continue;
+      int i = killOldest();
+      if (i >= 0)
+        killedNow.push_back(i);
+      addParticle();
+    }
+    parkParticles(killedNow);
+    if (mode == "serve" || recorder.recording() || compactionDue())
+      compactParticles();
 
-        Vec3f a = mesh.vertices()[i];
-        Vec3f b = mesh.vertices()[j];
-        Vec3f displacement = a - b;
+    if (taskGraph.get())
+      runStepGraph();
+    else
+      stepInOrder();
 
-        float distSqr = displacement.magSqr(); // alternatively float distance = displacement.mag(); --> (distance * distance);
-        float forceUnit = repulsionFactor / distSqr; 
-        forceUnit = min(forceUnit, 1.0f); // add a boundary to limit the maximum strength
+    vector<Vec3f> &position(mesh.vertices());
+    uploads.mark(MeshUploads::Positions, 0, position.size());
 
+    features.push(measured);
 
-        Vec3f direction = displacement.normalize();
-        Vec3f f = direction * forceUnit;
-        force[i] += f;
-        force[j] -= f;
+    recorder.record(position);
+    if (mode == "serve")
+      server.send({position, mesh.colors(), {}});
+  }
 
-        // i and j are a pair
-        // apply and equal and possible force
-        // as they get futher apart they influence each other much less
-        // as they get close to each other they influence each other a lot more
+  // the step one phase after another, as it always was
+  void stepInOrder()
+  {
+    vector<Vec3f> &position(mesh.vertices());
 
-        // limit large forces... if the force is too large, ignore it // they should slide thru each other
-      }
+    // springs strained past breakStrain snap (0: they never do)
+    float strain;
+    if (breakStrain > 0)
+    {
+      broken.clear();
+      strain = applySprings(position, spring_list.list(), force, breakStrain, broken);
+      spring_list.removeAt(broken);
     }
+    else
+      strain = applySprings(position, spring_list.list(), force);
+    measured.strain = perItem(strain, spring_list.size());
+    applyBoundary(position, boundarySize, force);
+    applyLikes(position, like_list.list(), force);
+    applyBuddies(position, buddy_list.list(), force);
 
+    // Calculate forces
+
+    if (sleeping.get())
+      sleep.applyRepulsion(position, repulsionFactor, force);
+    else
+      applyRepulsion(position, repulsionFactor, force);
 
     //
 
@@ -235,34 +490,173 @@ struct AlloApp : App
     // • .dot(Vec3f f)
     // • .cross(Vec3f f)
 
-    // drag
-    for (int i = 0; i < velocity.size(); i++)
+    applyDrag(velocity, dragFactor, force);
+    holdParked();
+    float energy;
+    if (sleeping.get())
+    {
+      sleep.update(velocity, force, spring_list, like_list, buddy_list);
+      energy = sleep.integrate(position, velocity, force, mass, timeStep);
+    }
+    else
     {
-      force[i] += -velocity[i] * dragFactor;
+      if (sleep.sleepers() > 0)
+        sleep.wakeAll();
+      energy = integrate(position, velocity, force, mass, timeStep);
     }
+    measured.energy = perItem(energy, velocity.size());
+    clearForces(force);
+  }
 
-    // Integration
-    //
+  static float perItem(float sum, int n) { return n > 0 ? sum / n : 0; }
+
+  // the same step as tasks: each force phase fills its own buffer, so they
+  // can all run at once. the GUI values for the next step are read next to
+  // any of it; the spring lines for onDraw need the integrated positions,
+  // so they are built after integration, next to clearing the forces
+  void buildStepGraph()
+  {
     vector<Vec3f> &position(mesh.vertices());
-    for (int i = 0; i < velocity.size(); i++)
+    auto &g = stepGraph;
+
+    g.add("springs", {&position, &spring_list, &params}, {&springForce, &broken, &measured.strain}, [&]()
+          {
+            springForce.assign(position.size(), Vec3f(0));
+            broken.clear();
+            float strain;
+            if (params.breakStrain > 0)
+              strain = applySprings(position, spring_list.list(), springForce, params.breakStrain, broken);
+            else
+              strain = applySprings(position, spring_list.list(), springForce);
+            measured.strain = perItem(strain, spring_list.size() - broken.size()); });
+    g.add("boundary", {&position, &params}, {&boundaryForce}, [&]()
+          {
+            boundaryForce.assign(position.size(), Vec3f(0));
+            applyBoundary(position, params.boundarySize, boundaryForce); });
+    g.add("likes", {&position, &like_list}, {&likeForce}, [&]()
+          {
+            likeForce.assign(position.size(), Vec3f(0));
+            applyLikes(position, like_list.list(), likeForce); });
+    g.add("buddies", {&position, &buddy_list}, {&buddyForce}, [&]()
+          {
+            buddyForce.assign(position.size(), Vec3f(0));
+            applyBuddies(position, buddy_list.list(), buddyForce); });
+    g.add("repulsion", {&position, &params}, {&repulsionForce, &sleep}, [&]()
+          {
+            repulsionForce.assign(position.size(), Vec3f(0));
+            if (params.sleeping)
+              sleep.applyRepulsion(position, params.repulsionFactor, repulsionForce);
+            else
+              applyRepulsion(position, params.repulsionFactor, repulsionForce); });
+    g.add("drag", {&velocity, &params}, {&dragForce}, [&]()
+          {
+            dragForce.assign(velocity.size(), Vec3f(0));
+            applyDrag(velocity, params.dragFactor, dragForce); });
+    g.add("break springs", {&broken}, {&spring_list}, [&]()
+          { spring_list.removeAt(broken); });
+    g.add("sum forces", {&springForce, &boundaryForce, &likeForce, &buddyForce, &repulsionForce, &dragForce},
+          {&force}, [&]()
+          {
+            for (int i = 0; i < force.size(); ++i)
+              force[i] += springForce[i] + boundaryForce[i] + likeForce[i] + buddyForce[i] +
+                          repulsionForce[i] + dragForce[i];
+            holdParked(); });
+    g.add("sleep", {&force, &params, &spring_list, &like_list, &buddy_list}, {&velocity, &sleep}, [&]()
+          {
+            if (params.sleeping)
+              sleep.update(velocity, force, spring_list, like_list, buddy_list);
+            else if (sleep.sleepers() > 0)
+              sleep.wakeAll(); });
+    g.add("integrate", {&force, &mass, &sleep, &params}, {&position, &velocity, &measured.energy}, [&]()
+          {
+            float energy = params.sleeping ? sleep.integrate(position, velocity, force, mass, params.timeStep)
+                                           : integrate(position, velocity, force, mass, params.timeStep);
+            measured.energy = perItem(energy, velocity.size()); });
+    g.add("clear forces", {}, {&force}, [&]()
+          { clearForces(force); });
+    g.add("spring lines", {&position, &spring_list}, {&springLines}, [&]()
+          { buildSpringLines(); });
+    g.add("GUI snapshot", {}, {&nextParams}, [&]()
+          { nextParams = snapshotParams(); });
+  }
+
+  void buildSpringLines()
+  {
+    springLines.clear();
+    for (int k = 0; k < spring_list.size(); ++k)
     {
-      // "semi-implicit" Euler integration
-      velocity[i] += force[i] / mass[i] * timeStep;
-      position[i] += velocity[i] * timeStep;
+      auto spring = spring_list[k];
+      springLines.push_back(mesh.vertices()[spring.i]);
+      springLines.push_back(mesh.vertices()[spring.j]);
     }
+  }
+
+  StepParams snapshotParams()
+  {
+    return {timeStep, dragFactor, repulsionFactor, boundarySize, breakStrain, sleeping.get() != 0};
+  }
+
+  void runStepGraph()
+  {
+    params = nextParams;
+    scheduler.tracing = traceNextStep;
+    scheduler.run(stepGraph);
+    linesFresh = true;
 
-    // clear all accelerations (IMPORTANT!!)
-    for (auto &a : force)
-      a.set(0);
+    if (traceNextStep)
+    {
+      scheduler.writeTrace("step-trace.json");
+      cout << "wrote step-trace.json (" << scheduler.workers() << " workers)" << endl;
+      traceNextStep = false;
+    }
   }
 
   bool onKeyDown(const Keyboard &k) override
   {
+    if (k.key() == 'c')
+    {
+      if (capture.recording())
+      {
+        if (capture.end("particles.scenario"))
+          cout << "checksum " << hex << stateChecksum() << dec << endl;
+      }
+      else
+      {
+        uint32_t seed = random_device()();
+        restart(seed);
+        capture.begin(seed);
+        settings(capture.scenario, false);
+      }
+      return true;
+    }
+    capture.key(k.key());
+
+    // new links only between live particles
+    if (k.key() >= '2' && k.key() <= '6')
+      compactParticles();
+
     if (k.key() == ' ')
     {
       freeze = !freeze;
     }
 
+    if (k.key() == 'r')
+    {
+      if (recorder.recording())
+      {
+        if (recorder.dropped() > 0) cout << recorder.dropped() << " frames dropped from particles.traj" << endl;
+        recorder.close();
+      }
+      else
+        recorder.open("particles.traj", Vec3f(-20), Vec3f(20));
+    }
+
+    if (k.key() == 'p')
+    {
+      playing = !playing && player.open("particles.traj") && player.frames() > 0;
+      playFrame = 0;
+    }
+
     if (k.key() == '1')
     {
       // introduce some "random" forces
@@ -284,7 +678,7 @@ struct AlloApp : App
       }
 
       // i and j are different particles ...
-      spring_list.push_back({i, j, 1.0, stiffness}); // default length and stiffness
+      spring_list.add({i, j, 1.0, stiffness}); // default length and stiffness
     }
 
     if (k.key() == '3')
@@ -297,7 +691,7 @@ struct AlloApp : App
         j = rnd::uniform(mesh.vertices().size());
       }
 
-      like_list.push_back({i, j, 0.1});
+      like_list.add({i, j, 0.1});
     }
 
     if (k.key() == '4')
@@ -310,57 +704,101 @@ struct AlloApp : App
         j = rnd::uniform(mesh.vertices().size());
       }
 
-      buddy_list.push_back({i, j, 30.0});
+      buddy_list.add({i, j, 30.0});
+    }
+
+    if (k.key() == '5')
+    {
+      // every particle to its nearest neighbours, at the distances they are now
+      vector<spring> network;
+      connectNearest(mesh.vertices(), neighbours, stiffness, network);
+      spring_list.add(network.begin(), network.end());
+      spring_list.compact();
     }
 
+    if (k.key() == '6')
+    {
+      vector<spring> network;
+      connectWithin(mesh.vertices(), linkRadius, stiffness, network);
+      spring_list.add(network.begin(), network.end());
+      spring_list.compact();
+    }
+
+    if (k.key() == 't')
+    {
+      traceNextStep = true;
+    }
+
+    // new links and kicks change the islands: start over with everyone awake
+    sleep.wakeAll();
+    linesFresh = false;
 
     return true;
   }
 
+  // a drone: the busier the particles the higher it goes, the more strained
+  // the springs the louder. no locks, no allocation, nothing but the queue
+  void onSound(AudioIOData &io) override
+  {
+    StepFeatures f;
+    while (features.pop(f))
+      heard = f;
+    pitch.target = 110 + 660 * min(sqrt(heard.energy), 1.0f);
+    loudness.target = heard.energy > 0 ? 0.05f + 0.2f * min(heard.strain, 1.0f) : 0;
+
+    double sampleRate = io.framesPerSecond();
+    while (io())
+    {
+      phase += pitch.next() / sampleRate;
+      phase -= floor(phase);
+      float s = sin(2 * M_PI * phase) * loudness.next();
+      io.out(0) = s;
+      io.out(1) = s;
+    }
+  }
+
   void onDraw(Graphics &g) override
   {
+    frameArena.beginFrame();
     g.clear(0.3);
     g.shader(pointShader);
     g.shader().uniform("pointSize", pointSize / 100);
     g.blending(true);
     g.blendTrans();
     g.depthTesting(true);
+    uploads.upload(mesh);
     g.draw(mesh);
 
     // reset to the default shader if we want to draw something else
 
     g.color(1.0, 1.0, 0.0); // resets shader...
 
-    Mesh springs(Mesh::LINES); // need to fill this part out
-    for (int k = 0; k < spring_list.size(); ++k)
-    {
-      auto spring = spring_list[k];
-      Vec3f a = mesh.vertices()[spring.i];
-      Vec3f b = mesh.vertices()[spring.j];
-      springs.vertex(a);
-      springs.vertex(b);
-    }
+    Mesh &springs = frameArena.mesh(Mesh::LINES); // need to fill this part out
+    if (!linesFresh)
+      buildSpringLines();
+    springs.vertices().assign(springLines.begin(), springLines.end());
 
     g.draw(springs);
+
+    frameArena.endFrame();
+
+    frameBudget.stop();
   }
 };
 
-int main()
+// ./particle           simulate and draw
+// ./particle serve     simulate, draw, and send the state to renderers
+// ./particle render    draw what a server on this machine sends
+// ./particle replay particles.scenario
+//                      run a captured scenario headless, print the frame
+//                      times and the final state's checksum
+int main(int argc, char *argv[])
 {
   AlloApp app;
+  if (argc > 1)
+    app.mode = argv[1];
+  if (app.mode == "replay")
+    return app.replay(argc > 2 ? argv[2] : "particles.scenario") ? 0 : 1;
   app.configureAudio(48000, 512, 2, 0);
   app.start();
 }
-
-string slurp(string fileName)
-{
-  fstream file(fileName);
-  string returnValue = "";
-  while (file.good())
-  {
-    string line;
-    getline(file, line);
-    returnValue += line + "\n";
-  }
-  return returnValue;
-}
@@ -0,0 +1,253 @@
+#pragma once
+
+// whole spring networks at once instead of one random spring per key press:
+// every particle to its k nearest neighbours, or every pair closer than a
+// radius. rest lengths are the current distances, so the network starts
+// relaxed and holds the shape the particles are in.
+//
+// both search a uniform grid (particle indices counting-sorted by cell)
+// and split the particles across threads; each thread writes its own
+// springs and the lists are joined at the end.
+
+#include "al/math/al_Vec.hpp"
+#include "particle-sim.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+#include <vector>
+
+using namespace al;
+
+// calls fn(begin, end, thread) on contiguous pieces of [0, n), one per core
+template <class F>
+void parallelFor(int n, F fn)
+{
+  int threads = std::max(1u, std::thread::hardware_concurrency());
+  threads = std::max(1, std::min(threads, n / 1024));
+  std::vector<std::thread> pool;
+  for (int t = 1; t < threads; ++t)
+    pool.emplace_back(fn, long(n) * t / threads, long(n) * (t + 1) / threads, t);
+  fn(0, long(n) / threads, 0);
+  for (auto &thread : pool)
+    thread.join();
+}
+
+struct PointGrid
+{
+  Vec3f min;
+  float cell = 1;
+  int nx = 1, ny = 1, nz = 1;
+  std::vector<int> start; // items of cell c are items[start[c] .. start[c + 1])
+  std::vector<int> items;
+
+  // cells at least minCell wide, holding about perCell points on average
+  void build(const std::vector<Vec3f> &position, float minCell, float perCell = 1)
+  {
+    Vec3f lo(1e30f), hi(-1e30f);
+    for (auto &p : position)
+      for (int k = 0; k < 3; ++k)
+      {
+        lo[k] = std::min(lo[k], p[k]);
+        hi[k] = std::max(hi[k], p[k]);
+      }
+    min = lo;
+    Vec3f extent = position.empty() ? Vec3f(1) : hi - lo;
+    cell = std::max(minCell, fitCell(extent, perCell / std::max<size_t>(position.size(), 1)));
+    nx = int(extent[0] / cell) + 1;
+    ny = int(extent[1] / cell) + 1;
+    nz = int(extent[2] / cell) + 1;
+
+    start.assign(size_t(nx) * ny * nz + 1, 0);
+    std::vector<int> cellOf(position.size());
+    for (int i = 0; i < position.size(); ++i)
+    {
+      cellOf[i] = index(coord(position[i], 0), coord(position[i], 1), coord(position[i], 2));
+      ++start[cellOf[i] + 1];
+    }
+    for (size_t c = 1; c < start.size(); ++c)
+      start[c] += start[c - 1];
+    items.resize(position.size());
+    std::vector<int> fill(start.begin(), start.end() - 1);
+    for (int i = 0; i < position.size(); ++i)
+      items[fill[cellOf[i]]++] = i;
+  }
+
+  // the side of a cube holding `share` of the box. an axis thinner than
+  // the cube (a flat sheet of cloth, a line) is one cell thick anyway, so
+  // it is left out and the cube is fitted to the other axes
+  static float fitCell(const Vec3f &extent, float share)
+  {
+    bool thin[3] = {!(extent[0] > 0), !(extent[1] > 0), !(extent[2] > 0)};
+    float cell = 1; // all points in one place
+    for (int pass = 0; pass < 3; ++pass)
+    {
+      float size = 1;
+      int axes = 0;
+      for (int k = 0; k < 3; ++k)
+        if (!thin[k])
+          size *= extent[k], ++axes;
+      if (axes == 0)
+        break;
+      cell = std::pow(size * share, 1.0f / axes);
+      bool dropped = false;
+      for (int k = 0; k < 3; ++k)
+        if (!thin[k] && extent[k] < cell)
+          thin[k] = dropped = true;
+      if (!dropped)
+        break;
+    }
+    return cell;
+  }
+
+  int coord(const Vec3f &p, int axis) const
+  {
+    int n[3] = {nx, ny, nz};
+    return std::min(std::max(int((p[axis] - min[axis]) / cell), 0), n[axis] - 1);
+  }
+
+  int index(int x, int y, int z) const { return (z * ny + y) * nx + x; }
+
+  // fn(i) for every point in the cells x0..x1, y0..y1, z0..z1 (clipped to the grid)
+  template <class F>
+  void forEachIn(int x0, int x1, int y0, int y1, int z0, int z1, F fn) const
+  {
+    x0 = std::max(x0, 0), y0 = std::max(y0, 0), z0 = std::max(z0, 0);
+    x1 = std::min(x1, nx - 1), y1 = std::min(y1, ny - 1), z1 = std::min(z1, nz - 1);
+    for (int z = z0; z <= z1; ++z)
+      for (int y = y0; y <= y1; ++y)
+        for (int x = x0; x <= x1; ++x)
+        {
+          int c = index(x, y, z);
+          for (int s = start[c]; s < start[c + 1]; ++s)
+            fn(items[s]);
+        }
+  }
+};
+
+// the k nearest other particles of every particle, k per row (-1 where
+// there are fewer than k others)
+inline std::vector<int> nearestNeighbours(const std::vector<Vec3f> &position, int k, const PointGrid &grid)
+{
+  std::vector<int> nearest(position.size() * k, -1);
+  parallelFor(position.size(), [&](int begin, int end, int) {
+    std::vector<std::pair<float, int>> best; // sorted, at most k
+    // in grid order, so neighbouring searches touch the same cells
+    for (int s = begin; s < end; ++s)
+    {
+      int i = grid.items[s];
+      best.clear();
+      const Vec3f &p = position[i];
+      int cx = grid.coord(p, 0), cy = grid.coord(p, 1), cz = grid.coord(p, 2);
+      int rings = std::max(grid.nx, std::max(grid.ny, grid.nz));
+      for (int r = 0; r < rings; ++r)
+      {
+        // only the shell of cells at distance r; the inside was done already
+        auto visit = [&](int j) {
+          if (j == i)
+            return;
+          float d = (position[j] - p).magSqr();
+          if (best.size() == k && d >= best.back().first)
+            return;
+          if (best.size() == k)
+            best.pop_back();
+          best.insert(std::upper_bound(best.begin(), best.end(), std::make_pair(d, j)), {d, j});
+        };
+        for (int z = cz - r; z <= cz + r; ++z)
+          for (int y = cy - r; y <= cy + r; ++y)
+          {
+            bool face = z == cz - r || z == cz + r || y == cy - r || y == cy + r;
+            if (face)
+              grid.forEachIn(cx - r, cx + r, y, y, z, z, visit);
+            else
+            {
+              grid.forEachIn(cx - r, cx - r, y, y, z, z, visit);
+              if (r > 0)
+                grid.forEachIn(cx + r, cx + r, y, y, z, z, visit);
+            }
+          }
+        // anything in ring r + 1 is at least r cells away
+        float reach = r * grid.cell;
+        if (best.size() == k && best.back().first <= reach * reach)
+          break;
+      }
+      for (int n = 0; n < best.size(); ++n)
+        nearest[size_t(i) * k + n] = best[n].second;
+    }
+  });
+  return nearest;
+}
+
+// joins the per-thread spring lists onto out
+inline void appendSprings(std::vector<std::vector<spring>> &parts, std::vector<spring> &out)
+{
+  size_t total = out.size();
+  for (auto &part : parts)
+    total += part.size();
+  out.reserve(total);
+  for (auto &part : parts)
+    out.insert(out.end(), part.begin(), part.end());
+}
+
+// a spring from every particle to each of its k nearest neighbours; a pair
+// that are each other's neighbours gets one spring, not two
+inline void connectNearest(const std::vector<Vec3f> &position, int k, float stiffness,
+                           std::vector<spring> &out)
+{
+  if (position.size() < 2 || k < 1)
+    return;
+  PointGrid grid;
+  grid.build(position, 0, k);
+  std::vector<int> nearest = nearestNeighbours(position, k, grid);
+
+  int threads = std::max(1u, std::thread::hardware_concurrency());
+  std::vector<std::vector<spring>> parts(threads);
+  parallelFor(position.size(), [&](int begin, int end, int thread) {
+    auto &part = parts[thread];
+    for (int i = begin; i < end; ++i)
+      for (int n = 0; n < k; ++n)
+      {
+        int j = nearest[size_t(i) * k + n];
+        if (j < 0)
+          continue;
+        // the mutual pair is added from the lower index only
+        const int *theirs = &nearest[size_t(j) * k];
+        if (j < i && std::find(theirs, theirs + k, i) != theirs + k)
+          continue;
+        part.push_back({i, j, (position[j] - position[i]).mag(), stiffness});
+      }
+  });
+  appendSprings(parts, out);
+}
+
+// a spring between every pair of particles closer than radius
+inline void connectWithin(const std::vector<Vec3f> &position, float radius, float stiffness,
+                          std::vector<spring> &out)
+{
+  if (position.size() < 2 || radius <= 0)
+    return;
+  PointGrid grid;
+  grid.build(position, radius);
+
+  int threads = std::max(1u, std::thread::hardware_concurrency());
+  std::vector<std::vector<spring>> parts(threads);
+  float radiusSqr = radius * radius;
+  parallelFor(position.size(), [&](int begin, int end, int thread) {
+    auto &part = parts[thread];
+    for (int s = begin; s < end; ++s)
+    {
+      int i = grid.items[s];
+      const Vec3f &p = position[i];
+      int cx = grid.coord(p, 0), cy = grid.coord(p, 1), cz = grid.coord(p, 2);
+      // cells are at least radius wide, so the neighbours are one cell away at most
+      grid.forEachIn(cx - 1, cx + 1, cy - 1, cy + 1, cz - 1, cz + 1, [&](int j) {
+        if (j <= i)
+          return;
+        float d = (position[j] - p).magSqr();
+        if (d < radiusSqr)
+          part.push_back({i, j, std::sqrt(d), stiffness});
+      });
+    }
+  });
+  appendSprings(parts, out);
+}
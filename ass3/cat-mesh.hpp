@@ -0,0 +1,90 @@
+#pragma once
+
+// the box cat, built from cubes merged into one mesh
+
+#include "al/graphics/al_Mesh.hpp"
+#include "al/graphics/al_Shapes.hpp"
+
+using namespace al;
+
+inline void appendMesh(Mesh &target, const Mesh &source) {
+  int vertexOffset = target.vertices().size();
+
+  // copy vertices, normals, and colors
+  for (int i = 0; i < source.vertices().size(); ++i) {
+    target.vertex(source.vertices()[i]);
+  }
+  for (int i = 0; i < source.normals().size(); ++i) {
+    target.normal(source.normals()[i]);
+  }
+  for (int i = 0; i < source.colors().size(); ++i) {
+    target.color(source.colors()[i]);
+  }
+  for (int i = 0; i < source.indices().size(); ++i) {
+    target.index(source.indices()[i] + vertexOffset);
+  }
+}
+
+inline Mesh createCatMesh() {
+  Mesh cat;
+  cat.primitive(Mesh::TRIANGLES);
+
+  auto makeBox = [&](Vec3f scale, Vec3f pos, Color color = Color(1, 0.5, 0)) {
+    Mesh m;
+    addCube(m);
+    m.scale(scale);
+    m.translate(pos);
+    for (int i = 0; i < m.vertices().size(); i++) {
+      m.color(color);
+    }
+    appendMesh(cat, m);
+  };
+
+  // body
+  makeBox({0.6f, 0.25f, 0.25f}, {0, 0.0f, 0}, Color(0.45f, 0.27f, 0.07f));
+
+  // head
+  makeBox({0.25f, 0.25f, 0.25f}, {0.45f, 0.05f, 0});
+
+  // tail base
+  makeBox({0.08f, 0.08f, 0.2f}, {-0.33f, 0.05f, 0.0f});
+
+  // tail tip
+  makeBox({0.06f, 0.06f, 0.15f}, {-0.33f, 0.12f, -0.15f}, Color(1));
+
+  // front left leg/paw
+  makeBox({0.08f, 0.2f, 0.08f}, {0.2f, -0.225f, 0.15f},
+          Color(0.45f, 0.27f, 0.07f));
+  makeBox({0.08f, 0.05f, 0.08f}, {0.2f, -0.325f, 0.15f},
+          Color(1));  // white paw
+
+  // front right leg/paw
+  makeBox({0.08f, 0.2f, 0.08f}, {0.2f, -0.225f, -0.15f});
+  makeBox({0.08f, 0.05f, 0.08f}, {0.2f, -0.325f, -0.15f},
+          Color(1));  // white paw
+
+  // back left leg/paw
+  makeBox({0.08f, 0.2f, 0.08f}, {-0.2f, -0.225f, 0.15f});
+  makeBox({0.08f, 0.05f, 0.08f}, {-0.2f, -0.325f, 0.15f},
+          Color(1));  // white paw
+
+  // back right leg/paw
+  makeBox({0.08f, 0.2f, 0.08f}, {-0.2f, -0.125f, -0.15f});
+  makeBox({0.08f, 0.05f, 0.08f}, {-0.2f, -0.225f, -0.15f},
+          Color(1));  // white paw
+
+  // ear left
+  makeBox({0.05f, 0.08f, 0.05f}, {0.52f, 0.18f, 0.1f});
+
+  // ear right
+  makeBox({0.05f, 0.08f, 0.05f}, {0.52f, 0.18f, -0.1f});
+
+  // left eye
+  makeBox({0.04f, 0.09f, 0.04f}, {0.60f, 0.12f, 0.06f}, Color(0));
+
+  // right eye
+  makeBox({0.04f, 0.09f, 0.04f}, {0.60f, 0.12f, -0.06f}, Color(0));
+
+  cat.generateNormals();
+  return cat;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+// flea pairing and movement from stable.cpp as free functions, so they can
+// also run outside the app (see bench/)
+
+#include "al/math/al_Random.hpp"
+#include "al/spatial/al_Pose.hpp"
+
+#include <vector>
+
+using namespace al;
+
+// fleas without a partner pair up with their closest free neighbour
+inline void pairFleas(const std::vector<Nav> &fleas, std::vector<int> &fleaTarget) {
+  for (int i = 0; i < fleas.size(); ++i) {
+    if (fleaTarget[i] >= 0) continue;  // skip flea if has partner
+
+    float closestDist = 200;
+    int closestIdx = -1;
+
+    for (int j = 0; j < fleas.size(); ++j) {
+      if (i == j) continue;  //  skip if comparing the flea to itself
+      if (fleaTarget[j] >= 0) continue;  // skip if flea j is has pair
+
+      float dist = (fleas[i].pos() - fleas[j].pos()).mag();
+
+      if (dist < closestDist) {
+        closestDist = dist;
+        closestIdx = j;
+      }
+    }
+
+    if (closestIdx != -1 && closestDist < 5.0f) {
+      fleaTarget[i] = closestIdx;
+      fleaTarget[closestIdx] = i;
+    }
+  }
+}
+
+// move toward partners and the cat, but never closer than repulsionFactor
+inline void stepFleas(std::vector<Nav> &fleas, std::vector<int> &fleaTarget, Vec3f catPos,
+                      float attractionFactor, float repulsionFactor, double dt) {
+  // pair w/ flea friend
+  for (int i = 0; i < fleas.size(); ++i) {
+    if (fleaTarget[i] >= 0) {
+      fleas[i].faceToward(fleas[fleaTarget[i]].pos(), 0.1);
+      fleas[i].nudgeToward(fleas[fleaTarget[i]].pos(), 0.05);
+
+      // randomly break up pairs
+      if (rnd::uniform() < 0.0005f) fleaTarget[i] = -1;
+    }
+
+    Vec3f fleaPos = fleas[i].pos();
+    Vec3f toCat = catPos - fleaPos;
+    float distance = toCat.mag();
+
+    if (repulsionFactor > 0 && distance < repulsionFactor) {
+      Vec3f correctedPos = catPos + toCat.normalize() * repulsionFactor;
+      fleas[i].pos(correctedPos);
+    }
+
+    fleas[i].faceToward(catPos, 0.1);
+    fleas[i].nudgeToward(catPos, attractionFactor);
+    fleas[i].moveF(0.02);
+    fleas[i].step(dt);
+  }
+}
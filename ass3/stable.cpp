@@ -3,10 +3,19 @@
 #include "al/graphics/al_Shapes.hpp"
 #include "al/math/al_Random.hpp"
 #include "al/math/al_Vec.hpp"
+#include "../feature-stream.hpp"
+#include "../frame-arena.hpp"
+#include "../frame-budget.hpp"
+#include "../scenario.hpp"
+#include "../state-link.hpp"
+#include "../trajectory.hpp"
+#include "cat-mesh.hpp"
+#include "fleas.hpp"
 
 using namespace al;
 
 #include <fstream>
+#include <random>
 #include <vector>
 using namespace std;
 
@@ -14,92 +23,31 @@ Vec3f randomVec3f(float scale) {
   return Vec3f(rnd::uniformS(), rnd::uniformS(), rnd::uniformS()) * scale;
 }
 
-void appendMesh(Mesh &target, const Mesh &source) {
-  int vertexOffset = target.vertices().size();
-
-  // copy vertices, normals, and colors
-  for (int i = 0; i < source.vertices().size(); ++i) {
-    target.vertex(source.vertices()[i]);
-  }
-  for (int i = 0; i < source.normals().size(); ++i) {
-    target.normal(source.normals()[i]);
-  }
-  for (int i = 0; i < source.colors().size(); ++i) {
-    target.color(source.colors()[i]);
-  }
-  for (int i = 0; i < source.indices().size(); ++i) {
-    target.index(source.indices()[i] + vertexOffset);
-  }
-}
-
-Mesh createCatMesh() {
-  Mesh cat;
-  cat.primitive(Mesh::TRIANGLES);
-
-  auto makeBox = [&](Vec3f scale, Vec3f pos, Color color = Color(1, 0.5, 0)) {
-    Mesh m;
-    addCube(m);
-    m.scale(scale);
-    m.translate(pos);
-    for (int i = 0; i < m.vertices().size(); i++) {
-      m.color(color);
-    }
-    appendMesh(cat, m);
-  };
-
-  // body
-  makeBox({0.6f, 0.25f, 0.25f}, {0, 0.0f, 0}, Color(0.45f, 0.27f, 0.07f));
-
-  // head
-  makeBox({0.25f, 0.25f, 0.25f}, {0.45f, 0.05f, 0});
-
-  // tail base
-  makeBox({0.08f, 0.08f, 0.2f}, {-0.33f, 0.05f, 0.0f});
-
-  // tail tip
-  makeBox({0.06f, 0.06f, 0.15f}, {-0.33f, 0.12f, -0.15f}, Color(1));
-
-  // front left leg/paw
-  makeBox({0.08f, 0.2f, 0.08f}, {0.2f, -0.225f, 0.15f},
-          Color(0.45f, 0.27f, 0.07f));
-  makeBox({0.08f, 0.05f, 0.08f}, {0.2f, -0.325f, 0.15f},
-          Color(1));  // white paw
-
-  // front right leg/paw
-  makeBox({0.08f, 0.2f, 0.08f}, {0.2f, -0.225f, -0.15f});
-  makeBox({0.08f, 0.05f, 0.08f}, {0.2f, -0.325f, -0.15f},
-          Color(1));  // white paw
-
-  // back left leg/paw
-  makeBox({0.08f, 0.2f, 0.08f}, {-0.2f, -0.225f, 0.15f});
-  makeBox({0.08f, 0.05f, 0.08f}, {-0.2f, -0.325f, 0.15f},
-          Color(1));  // white paw
-
-  // back right leg/paw
-  makeBox({0.08f, 0.2f, 0.08f}, {-0.2f, -0.125f, -0.15f});
-  makeBox({0.08f, 0.05f, 0.08f}, {-0.2f, -0.225f, -0.15f},
-          Color(1));  // white paw
+struct AlloApp : App {
+  Parameter timeStep{"/timeStep", "", 0.1, 0.01, 0.6};
+  Parameter attractionFactor{"/attraction to cat", "", 0.0, 0.01, 0.6};
+  Parameter repulsionFactor{"/revolution treatment", "", 0.0, 0.0, 2.6};
+  ParameterInt fleaCount{"/fleaCount", "", 100, 10, 5000};
 
-  // ear left
-  makeBox({0.05f, 0.08f, 0.05f}, {0.52f, 0.18f, 0.1f});
+  // adaptive quality: grows or shrinks fleaCount to fit the frame budget
+  FrameBudget frameBudget;
 
-  // ear right
-  makeBox({0.05f, 0.08f, 0.05f}, {0.52f, 0.18f, -0.1f});
+  // heap allocations per frame, on the GUI
+  FrameAllocations frameAllocations;
 
-  // left eye
-  makeBox({0.04f, 0.09f, 0.04f}, {0.60f, 0.12f, 0.06f}, Color(0));
+  // 'r' records the cat and flea poses to stable.traj (cat first)
+  TrajectoryRecorder recorder;
 
-  // right eye
-  makeBox({0.04f, 0.09f, 0.04f}, {0.60f, 0.12f, -0.06f}, Color(0));
+  // 'c' starts over from a new seed and captures the GUI settings and every
+  // key to stable.scenario until pressed again; "./stable replay
+  // stable.scenario" runs it again without a window
+  ScenarioRecorder capture;
 
-  cat.generateNormals();
-  return cat;
-}
-
-struct AlloApp : App {
-  Parameter timeStep{"/timeStep", "", 0.1, 0.01, 0.6};
-  Parameter attractionFactor{"/attraction to cat", "", 0.0, 0.01, 0.6};
-  Parameter repulsionFactor{"/revolution treatment", "", 0.0, 0.0, 2.6};
+  // "serve": simulate and send the cat and flea poses to renderers on port
+  // 9011; "render": simulate nothing, draw what the server sends
+  string mode;
+  StateServer server;
+  StateClient client;
 
   Light light;
   Material material;  // Necessary for specular highlights
@@ -109,6 +57,10 @@ struct AlloApp : App {
 
   Mesh floor;
 
+  // the owner and every flea are spheres; built once in onCreate
+  Mesh ownerMesh;
+  Mesh fleaMesh;
+
   Nav cameraNav;
   int cameraMode = 0;   // 0 = default, 1 = cat, 2 = flea
   int trackedFlea = 0;  // index of flea to follow
@@ -118,12 +70,52 @@ struct AlloApp : App {
   std::vector<float> fleaSize;
   std::vector<int> fleaTarget;
 
+  // what the audio hears: measured every step and queued for onSound, which
+  // only ever sees these two numbers
+  struct StepFeatures {
+    int pairs = 0;       // fleas with a partner, over two
+    float catSpeed = 0;  // per second
+  };
+  FeatureStream<StepFeatures> features;
+  Vec3f lastCatPos;
+
+  // audio thread only
+  StepFeatures heard;
+  Smoothed purr, clicks;
+  double buzz = 0, pulse = 0;
+  uint32_t noise = 1;
+
   void onInit() override {
     auto GUIdomain = GUIDomain::enableGUI(defaultWindowDomain());
     auto &gui = GUIdomain->newGUI();
     gui.add(timeStep);
     gui.add(attractionFactor);
     gui.add(repulsionFactor);
+    gui.add(fleaCount);
+    gui.add(frameBudget.budget);
+    gui.add(frameBudget.measured);
+    gui.add(frameBudget.adaptive);
+    gui.add(frameAllocations.allocations);
+  }
+
+  // adds fleas far away, or drops the last ones and breaks up their pairs
+  void resizeFleas(int n) {
+    while (fleas.size() < n) {
+      Nav f;
+      f.pos(randomVec3f(220.5));  // start far away
+      fleas.push_back(f);
+      fleaSize.push_back(rnd::uniform(0.008, 0.01));
+      fleaTarget.push_back(-1);  // unpaired until pairFleas()
+    }
+    if (fleas.size() <= n) return;
+
+    fleas.resize(n);
+    fleaSize.resize(n);
+    fleaTarget.resize(n);
+    for (auto &target : fleaTarget) {
+      if (target >= n) target = -1;
+    }
+    if (trackedFlea >= n) trackedFlea = 0;
   }
 
   void onCreate() override {
@@ -133,6 +125,11 @@ struct AlloApp : App {
     }
     floor.generateNormals();
 
+    addSphere(ownerMesh, 0.1);
+    ownerMesh.generateNormals();
+    addSphere(fleaMesh);
+    fleaMesh.generateNormals();
+
     nav().pos(0, 0, 10);
     // addSphere(mesh);
     // mesh.translate(0, 0, -0.1);
@@ -154,13 +151,10 @@ struct AlloApp : App {
 
     catNav.pos(Vec3f(0));
 
-    for (int i = 0; i < 100; ++i) {
-      Nav f;
-      f.pos(randomVec3f(220.5));  // start far away
-      fleas.push_back(f);
-      fleaSize.push_back(rnd::uniform(0.008, 0.01));
-      fleaTarget.push_back(rnd::uniform(catMesh.vertices().size()));
-    }
+    resizeFleas(fleaCount.get());
+
+    if (mode == "serve") server.open(9011, Vec3f(-250), Vec3f(250));
+    if (mode == "render") client.open("127.0.0.1", 9011);
 
     nav().pos(0, 0, 5);
   }
@@ -170,9 +164,97 @@ struct AlloApp : App {
 
   bool paused = true;
 
+  // as if just started (paused), with rnd seeded; the frame budget stops
+  // adapting so that fleaCount only changes when the scenario says so
+  void restart(uint32_t seed) {
+    rnd::global().seed(seed);
+    frameBudget.adaptive.set(false);
+    resizeFleas(0);
+    resizeFleas(fleaCount.get());
+    catNav = Nav();
+    lastCatPos = Vec3f(0);
+    owner = Vec3f(0);
+    time = 0;
+    paused = true;
+    cameraMode = 0;
+    trackedFlea = 0;
+  }
+
+  // every GUI value the step depends on
+  void settings(Scenario &s, bool apply) {
+    s.setting(timeStep, apply);
+    s.setting(attractionFactor, apply);
+    s.setting(repulsionFactor, apply);
+    s.setting(fleaCount, apply);
+  }
+
+  bool replay(const string &path) {
+    Scenario s;
+    if (!s.load(path)) return false;
+    settings(s, true);
+    onCreate();  // nothing in it needs the window
+    restart(s.seed);
+    ScenarioReport report = replayScenario(*this, s, [&]() { return stateChecksum(); });
+    report.print(cout, s.step);
+    report.writeTiming(path + ".timing.csv");
+    return true;
+  }
+
+  // what a replay prints, and capturing prints when it ends
+  uint64_t stateChecksum() {
+    WorldState state = poses();
+    return checksum(state.orientations, checksum(state.positions));
+  }
+
+  // cat first, then the fleas
+  WorldState poses() {
+    WorldState state;
+    state.positions.reserve(fleas.size() + 1);
+    state.orientations.reserve(fleas.size() + 1);
+    state.positions.push_back(catNav.pos());
+    state.orientations.push_back(Quatf(catNav.quat().w, catNav.quat().x, catNav.quat().y, catNav.quat().z));
+    for (auto &f : fleas) {
+      state.positions.push_back(f.pos());
+      state.orientations.push_back(Quatf(f.quat().w, f.quat().x, f.quat().y, f.quat().z));
+    }
+    return state;
+  }
+
+  void recordPoses() {
+    WorldState state = poses();
+    recorder.record(state.positions, state.orientations);
+  }
+
+  // the renderer's side of poses()
+  void showPoses(const WorldState &state) {
+    if (state.positions.empty()) return;
+    resizeFleas(state.positions.size() - 1);
+    for (int i = 0; i < state.positions.size(); ++i) {
+      Nav &n = i == 0 ? catNav : fleas[i - 1];
+      const Quatf &q = state.orientations[i];
+      n.pos(state.positions[i]);
+      n.quat(Quatd(q.w, q.x, q.y, q.z));
+    }
+  }
+
   void onAnimate(double dt) override {
+    frameBudget.start();
+    dt = capture.advance(dt);  // the scenario's fixed step while capturing
+
+    if (mode == "render") {
+      WorldState state;
+      if (client.receive(state)) showPoses(state);
+      return;
+    }
+
     if (paused) return;
 
+    // over budget: drop a fifth of the fleas; room to spare: add a tenth
+    int step = frameBudget.decide();
+    if (step < 0) fleaCount.set(std::max(10, int(fleaCount.get() * 0.8f)));
+    if (step > 0) fleaCount.set(std::min(5000, int(fleaCount.get() * 1.1f) + 1));
+    if (fleaCount.get() != fleas.size()) resizeFleas(fleaCount.get());
+
     if (cameraMode == 1) {
       float distance = (catNav.pos() - nav().pos()).mag();
       if (distance < 1) {
@@ -198,65 +280,42 @@ struct AlloApp : App {
     catNav.moveF(0.5);
     catNav.step(dt);
 
-    for (int i = 0; i < fleas.size(); ++i) {
-      if (fleaTarget[i] >= 0) continue;  // skip flea if has partner
-
-      float closestDist = 200;
-      int closestIdx = -1;
-
-      for (int j = 0; j < fleas.size(); ++j) {
-        if (i == j) continue;  //  skip if comparing the flea to itself
-        if (fleaTarget[j] >= 0) continue;  // skip if flea j is has pair
+    pairFleas(fleas, fleaTarget);
+    stepFleas(fleas, fleaTarget, catNav.pos(), attractionFactor, repulsionFactor, dt);
 
-        float dist = (fleas[i].pos() - fleas[j].pos()).mag();
-
-        if (dist < closestDist) {
-          closestDist = dist;
-          closestIdx = j;
-        }
-      }
-
-      if (closestIdx != -1 && closestDist < 5.0f) {
-        fleaTarget[i] = closestIdx;
-        fleaTarget[closestIdx] = i;
-      }
+    StepFeatures measured;
+    for (int target : fleaTarget) {
+      if (target >= 0) ++measured.pairs;
     }
-
-    // pair w/ flea friend
-    for (int i = 0; i < fleas.size(); ++i) {
-      if (fleaTarget[i] >= 0) {
-        fleas[i].faceToward(fleas[fleaTarget[i]].pos(), 0.1);
-        fleas[i].nudgeToward(fleas[fleaTarget[i]].pos(), 0.05);
-
-        // randomly break up pairs
-        if (rnd::uniform() < 0.0005f) fleaTarget[i] = -1;
-      }
-
-      Vec3f catPos = catNav.pos();
-      Vec3f fleaPos = fleas[i].pos();
-      Vec3f toCat = catPos - fleaPos;
-      float distance = toCat.mag();
-
-      if (repulsionFactor > 0 && distance < repulsionFactor) {
-        Vec3f correctedPos = catPos + toCat.normalize() * repulsionFactor;
-        fleas[i].pos(correctedPos);
-      }
-
-      fleas[i].faceToward(catPos, 0.1);
-      fleas[i].nudgeToward(catPos, attractionFactor);
-      fleas[i].moveF(0.02);
-      fleas[i].step(dt);
-    }
- 
+    measured.pairs /= 2;
+    if (dt > 0) measured.catSpeed = (Vec3f(catNav.pos()) - lastCatPos).mag() / dt;
+    lastCatPos = catNav.pos();
+    features.push(measured);
 
     if (cameraMode == 2 && fleas.size() > 0) {
       cameraNav.pos(fleas[trackedFlea].pos() + fleas[trackedFlea].uf() * -0.5 +
                     Vec3f(0, 0, 2));
       cameraNav.faceToward(fleas[trackedFlea].pos(), 1.0);
     }
+
+    if (recorder.recording()) recordPoses();
+    if (mode == "serve") server.send(poses());
   }
 
   bool onKeyDown(const Keyboard &k) override {
+    if (k.key() == 'c') {
+      if (capture.recording()) {
+        if (capture.end("stable.scenario")) cout << "checksum " << hex << stateChecksum() << dec << endl;
+      } else {
+        uint32_t seed = std::random_device()();
+        restart(seed);
+        capture.begin(seed);
+        settings(capture.scenario, false);
+      }
+      return true;
+    }
+    capture.key(k.key());
+
     if (k.key() == ' ') {
       paused = !paused;
     }
@@ -269,9 +328,49 @@ struct AlloApp : App {
     if (k.key() == '0') {
       cameraMode = 0;  //  freedom
     }
+    if (k.key() == 'r') {
+      // fleas start up to ~220 away, so the bounds are wide; they only
+      // clamp, each keyframe is quantised in a box around the fleas
+      if (recorder.recording()) {
+        if (recorder.dropped() > 0) cout << recorder.dropped() << " frames dropped from stable.traj" << endl;
+        recorder.close();
+      } else {
+        recorder.open("stable.traj", Vec3f(-250), Vec3f(250));
+      }
+    }
+    return true;
+  }
+
+  // the cat purrs faster the faster it walks, and every flea pair adds to
+  // the crackle. no locks, no allocation, nothing but the queue
+  void onSound(AudioIOData &io) override {
+    StepFeatures f;
+    while (features.pop(f)) heard = f;
+    purr.target = heard.catSpeed;
+    clicks.target = heard.pairs;
+
+    double sampleRate = io.framesPerSecond();
+    while (io()) {
+      // a 60 Hz buzz, silent standing still, pulsing faster and louder up
+      // to a walk of 1 per second
+      float walk = std::min(purr.next(), 1.0f);
+      buzz += 60 / sampleRate;
+      buzz -= std::floor(buzz);
+      pulse += (2 + 18 * walk) / sampleRate;
+      pulse -= std::floor(pulse);
+      float s = 0.1f * walk * std::sin(2 * M_PI * buzz) * std::max(0.0, std::sin(2 * M_PI * pulse));
+
+      // about four clicks a second per pair
+      noise = noise * 1664525u + 1013904223u;
+      if (noise / 4294967296.0 < clicks.next() * 4 / sampleRate) s += 0.3f;
+
+      io.out(0) = s;
+      io.out(1) = s;
+    }
   }
 
   void onDraw(Graphics &g) override {
+    frameAllocations.beginFrame();
 
     g.clear(255, 255, 255);
     g.depthTesting(true);
@@ -292,24 +391,18 @@ struct AlloApp : App {
     g.draw(catMesh);
     g.popMatrix();
 
-    Mesh m;
-    addSphere(m, 0.1);
-    m.generateNormals();
     g.pushMatrix();
     g.translate(owner);
     g.color(1, 0, 0);  // red color
-    g.draw(m);
+    g.draw(ownerMesh);
     g.popMatrix();
 
     for (int i = 0; i < fleas.size(); ++i) {
       g.pushMatrix();
       g.translate(fleas[i].pos());
       g.scale(fleaSize[i]);
-      Mesh m;
-      addSphere(m);
-      m.generateNormals();
       g.color(0, 0, 0);  // red flea
-      g.draw(m);
+      g.draw(fleaMesh);
       g.popMatrix();
     }
 
@@ -318,11 +411,22 @@ struct AlloApp : App {
     g.rotate(90, 1, 0, 0);
     g.scale(100);
     g.draw(floor);
+
+    frameAllocations.endFrame();
+    frameBudget.stop();
   }
 };
 
-int main() {
+// ./stable           simulate and draw
+// ./stable serve     simulate, draw, and send the poses to renderers
+// ./stable render    draw what a server on this machine sends
+// ./stable replay stable.scenario
+//                    run a captured scenario headless, print the frame
+//                    times and the final state's checksum
+int main(int argc, char *argv[]) {
   AlloApp app;
+  if (argc > 1) app.mode = argv[1];
+  if (app.mode == "replay") return app.replay(argc > 2 ? argv[2] : "stable.scenario") ? 0 : 1;
   app.configureAudio(48000, 512, 2, 0);
   app.start();
 }
\ No newline at end of file
@@ -0,0 +1,205 @@
+#pragma once
+
+// one loader for shaders and images, shared by every sketch
+//
+//   AssetLoader assets;
+//   assets.prefetch("../point-vertex.glsl");   // onInit, before the window exists
+//   assets.text("../point-vertex.glsl");       // onCreate, waits only if still reading
+//   assets.changed();                          // onAnimate, files edited since last call
+//
+// text files stay mapped (mmap) and text() is a view of the mapping, not a
+// copy; the mapping goes when the file changes on disk or the loader does.
+// on linux changes come from inotify; elsewhere the modification times are
+// polled.
+
+#include "al/graphics/al_Image.hpp"
+#include "al/graphics/al_Shader.hpp"
+
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+
+// a file mapped into memory for as long as this lives; empty if it could
+// not be read. without mmap it is read into a string instead
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path) {
+#if defined(__unix__) || defined(__APPLE__)
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            std::cerr << "could not read " << path << std::endl;
+            return;
+        }
+        struct stat info;
+        if (fstat(fd, &info) == 0 && info.st_size > 0) {
+            void* mapping = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapping != MAP_FAILED) {
+                data = static_cast<const char*>(mapping);
+                size = info.st_size;
+            }
+        }
+        close(fd);
+#else
+        std::ifstream file(path, std::ios::binary);
+        if (!file) std::cerr << "could not read " << path << std::endl;
+        contents.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        data = contents.data();
+        size = contents.size();
+#endif
+    }
+
+    ~MappedFile() {
+#if defined(__unix__) || defined(__APPLE__)
+        if (data) munmap(const_cast<char*>(data), size);
+#endif
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    std::string_view view() const { return std::string_view(data, size); }
+
+private:
+    const char* data = nullptr;
+    size_t size = 0;
+#if !defined(__unix__) && !defined(__APPLE__)
+    std::string contents;
+#endif
+};
+
+class AssetLoader {
+public:
+    ~AssetLoader() {
+#ifdef __linux__
+        if (notify >= 0) close(notify);
+#endif
+    }
+
+    // start reading a text file in the background
+    void prefetch(const std::string& path) {
+        if (texts.count(path)) return;
+        texts[path] = std::async(std::launch::async, [path]() {
+                          return std::make_shared<const MappedFile>(path);
+                      }).share();
+    }
+
+    // start decoding an image in the background
+    void prefetchImage(const std::string& path) {
+        if (images.count(path)) return;
+        images[path] = std::async(std::launch::async, [path]() {
+                           return std::make_shared<al::Image>(path);
+                       }).share();
+    }
+
+    // the mapped file itself: valid until changed() reports path
+    std::string_view text(const std::string& path) {
+        prefetch(path);
+        return texts[path].get()->view();
+    }
+
+    // allolib compiles from std::string, so this is the one place the
+    // shader sources are copied, once per compile
+    bool compile(al::ShaderProgram& shader, const std::string& vertex, const std::string& fragment,
+                 const std::string& geometry) {
+        return shader.compile(std::string(text(vertex)), std::string(text(fragment)),
+                              std::string(text(geometry)));
+    }
+
+    std::shared_ptr<al::Image> image(const std::string& path) {
+        prefetchImage(path);
+        return images[path].get();
+    }
+
+    // report path in changed() whenever it is written on disk
+    void watch(const std::string& path) {
+        if (!watched.insert(path).second) return;
+#ifdef __linux__
+        if (notify < 0) notify = inotify_init1(IN_NONBLOCK);
+        if (notify < 0) return;
+        // editors often replace the file, so watch the directory it is in
+        std::string dir = directoryOf(path);
+        int wd = inotify_add_watch(notify, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+        if (wd >= 0) directories[wd] = dir;
+#elif defined(__APPLE__) || defined(__unix__)
+        modified[path] = modifiedTime(path);
+#endif
+    }
+
+    // watched files written since the last call; their cached contents are
+    // dropped (and unmapped) so the next text()/image() reads them again.
+    // never blocks.
+    std::vector<std::string> changed() {
+        std::set<std::string> paths;
+#ifdef __linux__
+        if (notify >= 0) {
+            alignas(inotify_event) char buffer[4096];
+            ssize_t length;
+            while ((length = read(notify, buffer, sizeof(buffer))) > 0) {
+                for (char* p = buffer; p < buffer + length;) {
+                    auto* event = reinterpret_cast<inotify_event*>(p);
+                    if (event->len > 0 && directories.count(event->wd)) {
+                        std::string dir = directories[event->wd];
+                        std::string path = dir == "." ? event->name : dir + "/" + event->name;
+                        if (watched.count(path)) paths.insert(path);
+                    }
+                    p += sizeof(inotify_event) + event->len;
+                }
+            }
+        }
+#elif defined(__APPLE__) || defined(__unix__)
+        for (auto& entry : modified) {
+            auto time = modifiedTime(entry.first);
+            if (time != entry.second) {
+                entry.second = time;
+                paths.insert(entry.first);
+            }
+        }
+#endif
+        for (auto& path : paths) {
+            texts.erase(path);
+            images.erase(path);
+        }
+        return std::vector<std::string>(paths.begin(), paths.end());
+    }
+
+private:
+    std::map<std::string, std::shared_future<std::shared_ptr<const MappedFile>>> texts;
+    std::map<std::string, std::shared_future<std::shared_ptr<al::Image>>> images;
+    std::set<std::string> watched;
+
+    static std::string directoryOf(const std::string& path) {
+        auto slash = path.rfind('/');
+        return slash == std::string::npos ? "." : path.substr(0, slash);
+    }
+
+#ifdef __linux__
+    int notify = -1;
+    std::map<int, std::string> directories;
+#elif defined(__APPLE__) || defined(__unix__)
+    std::map<std::string, long long> modified;
+
+    static long long modifiedTime(const std::string& path) {
+        struct stat info;
+        if (stat(path.c_str(), &info) != 0) return 0;
+        return (long long)info.st_mtime;
+    }
+#endif
+};
@@ -0,0 +1,368 @@
+// microbenchmarks for the CPU hot paths of the sketches
+//
+// build it like any other sketch; it opens no window. from bench/bin:
+//
+//   ./bench                      run everything and compare to ../baseline.json
+//   ./bench --max 100000         only sizes up to 1e5
+//   ./bench --json out.json      also write the results to out.json
+//   ./bench --update-baseline    write the results as the new ../baseline.json
+//   ./bench --tolerance 0.25     allow 25% slowdown before failing (default 15%)
+//   ./bench --any-machine        compare against a baseline from another machine
+//
+// every kernel runs on synthetic input at 1e3, 1e4, ... 1e7 items. the
+// O(n*n) kernels (repulsion, flea pairing) stop at 1e4, flea stepping at
+// 1e5 (a Nav each; the GUI allows 5000 fleas), the spring networks at 1e6
+// particles (millions of springs, merged into an EdgeSet as the keys do). exits with 1 if any kernel got slower per item than the
+// baseline allows, if a kernel has no baseline entry, or if there is no
+// baseline. a baseline records the machine it was timed on (CPU, threads,
+// compiler, optimised or not) and is only compared against runs on the
+// same one: a tolerance means nothing across hardware. so there is no
+// baseline in the repository; record one with --update-baseline on the
+// machine, from a release build against the real allolib.
+
+#include "al/math/al_Random.hpp"
+
+#include "../ass2/edge-set.hpp"
+#include "../ass2/particle-sim.hpp"
+#include "../ass2/spring-network.hpp"
+#include "../ass3/cat-mesh.hpp"
+#include "../ass3/fleas.hpp"
+#include "../point-layouts.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef __APPLE__
+#include <sys/sysctl.h>
+#endif
+
+using namespace al;
+
+struct Result {
+    std::string name;
+    long size;
+    double nsPerItem;
+};
+
+// where a set of results was timed
+struct Machine {
+    std::string cpu, compiler;
+    int threads = 0;
+    bool optimised = false;
+
+    bool operator==(const Machine& other) const {
+        return cpu == other.cpu && compiler == other.compiler && threads == other.threads &&
+               optimised == other.optimised;
+    }
+};
+
+Machine thisMachine() {
+    Machine m;
+#if defined(__APPLE__)
+    char brand[256] = {};
+    size_t length = sizeof(brand) - 1;
+    if (sysctlbyname("machdep.cpu.brand_string", brand, &length, nullptr, 0) == 0) m.cpu = brand;
+#else
+    std::ifstream info("/proc/cpuinfo");
+    for (std::string line; m.cpu.empty() && std::getline(info, line);) {
+        if (line.compare(0, 10, "model name") == 0) m.cpu = line.substr(line.find(':') + 2);
+    }
+#endif
+    if (m.cpu.empty()) m.cpu = "unknown";
+#ifdef __VERSION__
+    m.compiler = __VERSION__;
+#endif
+    m.threads = std::thread::hardware_concurrency();
+#ifdef NDEBUG
+    m.optimised = true;
+#endif
+    // the JSON reader below knows no escapes
+    for (auto* text : {&m.cpu, &m.compiler}) std::replace(text->begin(), text->end(), '"', '\'');
+    return m;
+}
+
+std::ostream& operator<<(std::ostream& out, const Machine& m) {
+    return out << m.cpu << ", " << m.threads << " threads, " << m.compiler
+               << (m.optimised ? "" : ", not optimised");
+}
+
+// best of several runs, at least 3 and at least 0.2 s in total
+double measure(long items, const std::function<void()>& run) {
+    using clock = std::chrono::steady_clock;
+    double best = 1e300, total = 0;
+    for (int rep = 0; rep < 3 || (total < 0.2 && rep < 1000); ++rep) {
+        auto start = clock::now();
+        run();
+        double seconds = std::chrono::duration<double>(clock::now() - start).count();
+        best = std::min(best, seconds);
+        total += seconds;
+    }
+    return best * 1e9 / items;
+}
+
+Vec3f randomVec3f(float scale) {
+    return Vec3f(rnd::uniformS(), rnd::uniformS(), rnd::uniformS()) * scale;
+}
+
+std::vector<uint8_t> randomPixels(long count) {
+    std::vector<uint8_t> pixels(count * 4);
+    for (auto& p : pixels) p = rnd::uniform(256);
+    return pixels;
+}
+
+void benchParticles(long n, std::vector<Result>& results) {
+    std::vector<Vec3f> position(n), velocity(n), force(n);
+    std::vector<float> mass(n, 3.0f);
+    for (long i = 0; i < n; ++i) {
+        position[i] = randomVec3f(5);
+        velocity[i] = randomVec3f(0.1);
+    }
+    std::vector<spring> springs(n);
+    for (auto& s : springs) {
+        s = {int(rnd::uniform(n)), int(rnd::uniform(n)), 1.0f, 1.0f};
+    }
+    // integrate moves the particles further apart with every run; the
+    // kernels that care about the spread get them as they started
+    const std::vector<Vec3f> start = position;
+
+    results.push_back({"ass2/springs", n, measure(n, [&] { applySprings(position, springs, force); })});
+    results.push_back({"ass2/drag", n, measure(n, [&] { applyDrag(velocity, 0.1f, force); })});
+    results.push_back({"ass2/integrate", n, measure(n, [&] {
+                           integrate(position, velocity, force, mass, 0.01f);
+                           clearForces(force);
+                       })});
+    if (n <= 1000000) {
+        std::vector<spring> network;
+        results.push_back({"ass2/connectNearest", n, measure(n, [&] {
+                               network.clear();
+                               connectNearest(start, 6, 1.0f, network);
+                           })});
+
+        // the '5' and '6' keys end to end: the network, merged into the
+        // spring list (a hash insert per spring) and sorted. 3.5 to 4
+        // springs a particle either way, so millions at 1e6
+        EdgeSet<spring> springList;
+        auto merge = [&] {
+            springList.clear();
+            springList.add(network.begin(), network.end());
+            springList.compact();
+        };
+        results.push_back({"ass2/nearestNetwork", n, measure(n, [&] {
+                               network.clear();
+                               connectNearest(start, 6, 1.0f, network);
+                               merge();
+                           })});
+        // the radius that holds 8 others on average in the cube of side 10
+        float radius = std::cbrt(8 * 1000 * 3 / (4 * float(M_PI) * n));
+        results.push_back({"ass2/withinNetwork", n, measure(n, [&] {
+                               network.clear();
+                               connectWithin(start, radius, 1.0f, network);
+                               merge();
+                           })});
+    }
+    if (n <= 10000) {
+        long pairs = n * (n - 1) / 2;
+        results.push_back({"ass2/repulsion", n, measure(pairs, [&] { applyRepulsion(start, 0.1f, force); })});
+    }
+}
+
+void benchFleas(long n, std::vector<Result>& results) {
+    if (n > 100000) return;
+    std::vector<Nav> fleas(n);
+    std::vector<int> fleaTarget(n, -1);
+    for (auto& f : fleas) f.pos(randomVec3f(20));
+
+    if (n <= 10000) {
+        long pairs = n * n;
+        results.push_back({"ass3/pairFleas", n, measure(pairs, [&] {
+                               std::fill(fleaTarget.begin(), fleaTarget.end(), -1);
+                               pairFleas(fleas, fleaTarget);
+                           })});
+    }
+    results.push_back({"ass3/stepFleas", n, measure(n, [&] {
+                           stepFleas(fleas, fleaTarget, Vec3f(0), 0.01f, 0.5f, 0.016);
+                       })});
+}
+
+void benchLayouts(long n, std::vector<Result>& results) {
+    int w = 1000 < n ? 1000 : n;
+    int h = n / w;
+    auto pixels = randomPixels(long(w) * h);
+    long count = long(w) * h;
+
+    Mesh imageMesh, rgbCubeMesh, randomMesh;
+    results.push_back({"main/fillPointClouds", count, measure(count, [&] {
+                           fillPointClouds(pixels.data(), w, h, imageMesh, rgbCubeMesh, randomMesh);
+                       })});
+
+    std::map<std::string, PackedCloud> layouts;
+    results.push_back({"revisedmain/buildLayouts", count, measure(count, [&] {
+                           buildLayouts(pixels.data(), w, h, layouts);
+                       })});
+
+    std::vector<Vec3f> positions(count);
+    results.push_back({"revisedmain/lerpLayouts", count, measure(count, [&] {
+                           lerpLayouts(layouts["image"], layouts["hsv"], 0.5f, positions);
+                       })});
+}
+
+void benchMeshes(long n, std::vector<Result>& results) {
+    Mesh source;
+    for (long i = 0; i < n; ++i) {
+        source.vertex(randomVec3f(1));
+        source.normal(Vec3f(0, 1, 0));
+        source.color(Color(1, 0.5, 0));
+    }
+    Mesh target;
+    results.push_back({"ass3/appendMesh", n, measure(n, [&] {
+                           target.reset();
+                           appendMesh(target, source);
+                       })});
+}
+
+void writeJson(const std::string& path, const Machine& machine, const std::vector<Result>& results) {
+    std::ofstream out(path);
+    out << "{\n  \"machine\": {\"cpu\": \"" << machine.cpu << "\", \"threads\": " << machine.threads
+        << ", \"compiler\": \"" << machine.compiler << "\", \"optimised\": " << machine.optimised << "},\n";
+    out << "  \"results\": [\n";
+    for (int i = 0; i < results.size(); ++i) {
+        out << "    {\"name\": \"" << results[i].name << "\", \"size\": " << results[i].size
+            << ", \"ns_per_item\": " << results[i].nsPerItem << "}"
+            << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+    out << "  ]\n}\n";
+}
+
+// reads back what writeJson wrote; false if there is no such file
+bool readJson(const std::string& path, Machine& machine, std::vector<Result>& results) {
+    std::ifstream in(path);
+    if (!in) return false;
+    std::stringstream buffer;
+    buffer << in.rdbuf();
+    std::string text = buffer.str();
+
+    auto field = [&](size_t from, const std::string& key) {
+        size_t at = text.find("\"" + key + "\":", from);
+        return at == std::string::npos ? at : at + key.size() + 3;
+    };
+    auto string = [&](size_t at) {
+        size_t open = text.find('"', at), close = text.find('"', open + 1);
+        return text.substr(open + 1, close - open - 1);
+    };
+
+    size_t list = text.find("\"results\"");
+    size_t at = text.find("\"machine\"");
+    if (at < list) {
+        size_t cpu = field(at, "cpu"), threads = field(at, "threads"), compiler = field(at, "compiler"),
+               optimised = field(at, "optimised");
+        if (std::max({cpu, threads, compiler, optimised}) < list) {
+            machine.cpu = string(cpu);
+            machine.threads = std::atoi(text.c_str() + threads);
+            machine.compiler = string(compiler);
+            machine.optimised = std::atoi(text.c_str() + optimised);
+        }
+    }
+
+    results.clear();
+    for (at = text.find('{', list); at != std::string::npos; at = text.find('{', at + 1)) {
+        size_t name = field(at, "name"), size = field(at, "size"), ns = field(at, "ns_per_item");
+        if (name == std::string::npos || size == std::string::npos || ns == std::string::npos) break;
+        results.push_back({string(name), std::atol(text.c_str() + size), std::atof(text.c_str() + ns)});
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    long maxSize = 10000000;
+    double tolerance = 0.15;
+    std::string baselinePath = "../baseline.json", jsonPath;
+    bool updateBaseline = false, anyMachine = false;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--max" && i + 1 < argc) maxSize = std::atol(argv[++i]);
+        else if (arg == "--tolerance" && i + 1 < argc) tolerance = std::atof(argv[++i]);
+        else if (arg == "--baseline" && i + 1 < argc) baselinePath = argv[++i];
+        else if (arg == "--json" && i + 1 < argc) jsonPath = argv[++i];
+        else if (arg == "--update-baseline") updateBaseline = true;
+        else if (arg == "--any-machine") anyMachine = true;
+        else {
+            std::cerr << "unknown argument " << arg << std::endl;
+            return 2;
+        }
+    }
+
+    // before the minutes of timing, so that a useless run stops early
+    Machine machine = thisMachine(), baselineMachine;
+    std::vector<Result> baseline;
+    if (!updateBaseline) {
+        if (!readJson(baselinePath, baselineMachine, baseline)) {
+            std::cout << "no baseline at " << baselinePath
+                      << "; record one on this machine with --update-baseline" << std::endl;
+            return 1;
+        }
+        if (!(baselineMachine == machine)) {
+            std::cout << baselinePath << " was timed on another machine:\n  " << baselineMachine
+                      << "\nthis is\n  " << machine << std::endl;
+            if (!anyMachine) return 1;
+        }
+    }
+
+    rnd::global().seed(1);
+    std::vector<Result> results;
+
+    results.push_back({"ass3/createCatMesh", 1, measure(1, [] { createCatMesh(); })});
+    for (long n = 1000; n <= maxSize; n *= 10) {
+        benchParticles(n, results);
+        benchFleas(n, results);
+        benchLayouts(n, results);
+        benchMeshes(n, results);
+    }
+
+    if (!jsonPath.empty()) writeJson(jsonPath, machine, results);
+    if (updateBaseline) {
+        writeJson(baselinePath, machine, results);
+        std::cout << "wrote " << results.size() << " results to " << baselinePath << " (" << machine << ")"
+                  << std::endl;
+        return 0;
+    }
+
+    int regressions = 0, missing = 0;
+    for (auto& r : results) {
+        const Result* base = nullptr;
+        for (auto& b : baseline) {
+            if (b.name == r.name && b.size == r.size) base = &b;
+        }
+
+        printf("%-26s %9ld %12.3f ns/item", r.name.c_str(), r.size, r.nsPerItem);
+        if (base) {
+            double change = r.nsPerItem / base->nsPerItem - 1;
+            bool slower = change > tolerance;
+            regressions += slower;
+            printf("  %+6.1f%%%s", change * 100, slower ? "  REGRESSION" : "");
+        } else {
+            ++missing;
+            printf("  NO BASELINE");
+        }
+        printf("\n");
+    }
+
+    if (regressions > 0) {
+        std::cout << regressions << " kernels are more than " << tolerance * 100
+                  << "% slower than " << baselinePath << std::endl;
+    }
+    if (missing > 0) {
+        std::cout << missing << " kernels have no entry in " << baselinePath
+                  << "; record it again with --update-baseline" << std::endl;
+    }
+    return regressions > 0 || missing > 0;
+}
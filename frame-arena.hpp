@@ -0,0 +1,98 @@
+#pragma once
+
+// meshes that only live for one onDraw, and the heap allocations per frame
+//
+//   onDraw:  frameArena.beginFrame();
+//            Mesh& lines = frameArena.mesh(Mesh::LINES);   // instead of Mesh lines(...)
+//            ...
+//            frameArena.endFrame();
+//
+// meshes come from a pool and are reset() instead of freed, so they keep
+// last frame's capacity; once the frame sizes settle they allocate nothing.
+// endFrame() puts the heap allocations of the frame on the GUI: the pool's
+// own (new meshes, meshes that grew), or, built with
+// -DFRAME_ARENA_COUNT_NEW and frame-arena-count.cpp among the sources,
+// every operator new in the process between beginFrame() and endFrame(),
+// on any thread. a sketch with nothing to pool uses FrameAllocations for
+// the count alone.
+
+#include "al/graphics/al_Mesh.hpp"
+#include "al/ui/al_Parameter.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <deque>
+
+using namespace al;
+
+// every operator new so far, when frame-arena-count.cpp replaces it
+inline std::atomic<size_t>& heapAllocations() {
+    static std::atomic<size_t> count{0};
+    return count;
+}
+
+// only the count; stays 0 unless operator new is counted
+class FrameAllocations {
+public:
+    al::Parameter allocations{"/frameAllocations", "", 0.0, 0.0, 100.0};  // heap allocations last frame
+
+    void beginFrame() { before = heapAllocations(); }
+    void endFrame() { allocations.set(heapAllocations() - before); }
+
+private:
+    size_t before = 0;
+};
+
+class FrameArena {
+public:
+    al::Parameter allocations{"/frameAllocations", "", 0.0, 0.0, 100.0};  // heap allocations last frame
+    al::Parameter kilobytes{"/frameKiB", "", 0.0, 0.0, 10000.0};          // pooled mesh bytes
+
+    void beginFrame() {
+        newsBefore = heapAllocations();
+        meshesUsed = 0;
+        meshBytesBefore = meshBytes();
+    }
+
+    // a cleared mesh that keeps the capacity it had last frame
+    Mesh& mesh(Mesh::Primitive primitive = Mesh::TRIANGLES) {
+        if (meshesUsed == meshes.size()) {
+            meshes.emplace_back();
+            ++heap;
+        }
+        Mesh& m = meshes[meshesUsed++];
+        m.reset();
+        m.primitive(primitive);
+        return m;
+    }
+
+    void endFrame() {
+        // a mesh that outgrew last frame's capacity reallocated
+        size_t bytes = meshBytes();
+        if (bytes > meshBytesBefore) ++heap;
+#ifdef FRAME_ARENA_COUNT_NEW
+        allocations.set(heapAllocations() - newsBefore);
+#else
+        allocations.set(heap);
+#endif
+        kilobytes.set(bytes / 1024.0);
+        heap = 0;
+    }
+
+private:
+    std::deque<Mesh> meshes;  // deque: handed-out references stay valid
+    size_t meshesUsed = 0;
+    size_t meshBytesBefore = 0;
+    size_t newsBefore = 0;
+    int heap = 0;  // the pool's own, when operator new is not counted
+
+    size_t meshBytes() const {
+        size_t bytes = 0;
+        for (auto& m : meshes) {
+            bytes += m.vertices().capacity() * sizeof(Vec3f) + m.normals().capacity() * sizeof(Vec3f) +
+                     m.colors().capacity() * sizeof(Color) + m.texCoord2s().capacity() * sizeof(Vec2f) +
+                     m.indices().capacity() * sizeof(unsigned);
+        }
+        return bytes;
+    }
+};
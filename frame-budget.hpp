@@ -0,0 +1,59 @@
+#pragma once
+
+// adaptive quality: time onAnimate + onDraw against a frame budget and say
+// when there is room to do more or when to do less
+//
+//   onAnimate:  frameBudget.start();  int step = frameBudget.decide();
+//   onDraw:     ... frameBudget.stop();
+//
+// the time is smoothed and has to stay over (or well under) the budget for
+// a number of frames before decide() answers, and it waits after each
+// change to see its effect, so quality does not flicker back and forth.
+
+#include "al/ui/al_Parameter.hpp"
+
+#include <chrono>
+
+class FrameBudget {
+public:
+    al::Parameter budget{"/frameBudgetMs", "", 12.0, 1.0, 50.0};  // target for animate + draw
+    al::Parameter measured{"/frameMs", "", 0.0, 0.0, 50.0};       // smoothed, for the GUI
+    al::ParameterBool adaptive{"/adaptive", "", 1.0};
+
+    int patience = 10;   // frames over/under budget before acting
+    int settle = 30;     // frames to wait after a change
+    float headroom = 0.75;  // raise quality only below this fraction of the budget
+
+    void start() { begin = clock::now(); }
+
+    void stop() {
+        double ms = std::chrono::duration<double, std::milli>(clock::now() - begin).count();
+        smoothed = smoothed == 0 ? ms : smoothed * 0.9 + ms * 0.1;
+        measured.set(smoothed);
+    }
+
+    // -1: over budget, lower quality. +1: room to raise it. 0: leave it
+    int decide() {
+        if (!adaptive.get() || smoothed == 0) return 0;
+        if (wait > 0) {
+            --wait;
+            return 0;
+        }
+
+        over = smoothed > budget ? over + 1 : 0;
+        under = smoothed < budget * headroom ? under + 1 : 0;
+
+        int step = over >= patience ? -1 : under >= patience ? 1 : 0;
+        if (step != 0) {
+            over = under = 0;
+            wait = settle;
+        }
+        return step;
+    }
+
+private:
+    using clock = std::chrono::steady_clock;
+    clock::time_point begin = clock::now();
+    double smoothed = 0;
+    int over = 0, under = 0, wait = 0;
+};
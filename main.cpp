@@ -2,109 +2,164 @@
 #include "al/graphics/al_Image.hpp" 
 #include "al/app/al_GUIDomain.hpp"
 #include "al/math/al_Random.hpp"
+#include "asset-loader.hpp"
+#include "packed-mesh.hpp"
+#include "packed-points.hpp"
+#include "point-chunks.hpp"
+#include "point-layouts.hpp"
+#include "point-order.hpp"
 using namespace al;
-#include <fstream> // for slurp()
-#include <string> // for slurp()
+#include <map>
+#include <string>
 
 Vec3f rvec() { return Vec3f(rnd::uniformS(), rnd::uniformS(), rnd::uniformS()); }
 RGB rcolor() { return RGB(rnd::uniform(), rnd::uniform(), rnd::uniform()); }
 
-std::string slurp(std::string fileName); // only a declaration
 class MyApp : public App {
-    Mesh grid, rgb, hsl, mine;
-    Mesh mesh;
-    Mesh imageMesh; 
-    Mesh rgbCubeMesh;
-    Mesh randomMesh;
-
+    // the layouts, 16-bit positions and RGBA8 colours; they stay packed on
+    // the GPU too (packed-mesh.hpp)
+    PackedCloud imageCloud;
+    PackedCloud rgbCubeCloud;
+    PackedCloud randomCloud;
+    PackedCloud spaceCloud; // refilled by the space key
+
+    // the layout on screen; keys swap this pointer instead of copying points
+    PackedCloud* cloud = &imageCloud;
+
+    // what is on the GPU: all of drawnCloud, or the drawnChunks of it. it
+    // goes up again only when that changes
+    PackedMesh gpu;
+    const PackedCloud* drawnCloud = nullptr;
+    bool drawnCulled = false;
+    bool resend = false;
+
+    // view-frustum culling: only the chunks in view are copied to visiblePoints
+    bool culling = true;
+    std::map<const PackedCloud*, std::vector<PointChunk>> chunks;
+    std::vector<VisibleChunk> visible, drawnChunks;
+    std::vector<PackedPoint> visiblePoints;
+
+    AssetLoader assets;
     ShaderProgram shader;
     Parameter pointSize{"pointSize", 0.004, 0.0005, 0.015};
+    Parameter lodDistance{"lodDistance", 3.0, 0.1, 20.0};
 
     void onInit() override {
         auto GUIdomain = GUIDomain::enableGUI(defaultWindowDomain());
         auto &gui = GUIdomain->newGUI();
         gui.add(pointSize);
+        gui.add(lodDistance);
+
+        // read the shaders and decode the image while the window opens
+        for (auto path : {"../point-vertex.glsl", "../point-fragment.glsl", "../point-geometry.glsl"}) {
+            assets.prefetch(path);
+            assets.watch(path);
+        }
+        assets.prefetchImage("../rainbow.jpg");
+        assets.watch("../rainbow.jpg");
+    }
+
+    bool compileShader() {
+        return assets.compile(shader, "../point-vertex.glsl", "../point-fragment.glsl",
+                              "../point-geometry.glsl");
+    }
+
+    // packs the points of m along a Hilbert curve into c and cuts them
+    // into chunks
+    void pack(Mesh& m, PackedCloud& c) {
+        auto order = spaceFillingOrder(m.vertices());
+        applyOrder(m.vertices(), order);
+        applyOrder(m.colors(), order);
+        c.fromMesh(m);
+        chunks[&c] = makeChunks(c.positions());
+        drawnCloud = nullptr;
     }
 
     void onCreate() override {
-        auto image = Image("../rainbow.jpg");
-        if (image.width() == 0) {
+        auto image = assets.image("../rainbow.jpg");
+        if (image->width() == 0) {
             std::cout << "Image not found" << std::endl;
             exit(1);
         }
 
-        mesh.primitive(Mesh::POINTS);
-        imageMesh.primitive(Mesh::POINTS); //
-
-        for (int y = 0; y < image.height(); ++y) {
-            for (int x = 0; x < image.width(); ++x) {
-                auto pixel = image.at(x, y);
-                float px = float(x) / image.width();
-                float py = float(y) / image.height();
-                Color c(pixel.r / 255.0, pixel.g / 255.0, pixel.b / 255.0);
-
-                mesh.vertex(px, py, 0);
-                mesh.color(c);
-                mesh.texCoord(0.1, 0);
+        buildClouds(*image);
+        nav().pos(0, 0, 5);
 
-                imageMesh.vertex(px, py, 0);  
-                imageMesh.color(c);
-                imageMesh.texCoord(0.1, 0);
-            }
+        if (!compileShader()) {
+            printf("Shader failed to compile\n");
+            exit(1);
         }
-
-        rgbCubeMesh.primitive(Mesh::POINTS);
-
-        for (int y = 0; y < image.height(); ++y) {
-        for (int x = 0; x < image.width(); ++x) {
-        auto pixel = image.at(x, y);
-        float r = pixel.r / 255.0f;
-        float g = pixel.g / 255.0f;
-        float b = pixel.b / 255.0f;
-
-        rgbCubeMesh.vertex(r, g, b);        
-        rgbCubeMesh.color(r, g, b);          
-        rgbCubeMesh.texCoord(0.1, 0);
     }
-}
-
-randomMesh.primitive(Mesh::POINTS);
 
-for (int y = 0; y < image.height(); ++y) {
-    for (int x = 0; x < image.width(); ++x) {
-        auto pixel = image.at(x, y);
-        float r = pixel.r / 255.0f;
-        float g = pixel.g / 255.0f;
-        float b = pixel.b / 255.0f;
-
-        Vec3f randPos = rvec(); 
-        randomMesh.vertex(randPos);
-        randomMesh.color(r, g, b);
-        randomMesh.texCoord(0.1, 0);
+    void buildClouds(const Image& image) {
+        Mesh imageMesh, rgbCubeMesh, randomMesh;
+        fillPointClouds(image.array().data(), image.width(), image.height(),
+                        imageMesh, rgbCubeMesh, randomMesh);
+        pack(imageMesh, imageCloud);
+        pack(rgbCubeMesh, rgbCubeCloud);
+        pack(randomMesh, randomCloud);
+
+        for (PackedCloud* c : {&imageCloud, &rgbCubeCloud, &randomCloud}) {
+            std::cout << meshBytes(c->size()) / 1024 << " KiB as a Mesh, "
+                      << c->bytes() / 1024 << " KiB packed" << std::endl;
+        }
     }
-}
-
-
-        nav().pos(0, 0, 5);
 
-        if (!shader.compile(slurp("../point-vertex.glsl"), slurp("../point-fragment.glsl"), slurp("../point-geometry.glsl"))) {
-            printf("Shader failed to compile\n");
-            exit(1);
+    // picks up edited shaders and images without restarting
+    void reloadChangedAssets() {
+        bool shaderChanged = false;
+        for (auto& path : assets.changed()) {
+            if (path == "../rainbow.jpg") {
+                auto image = assets.image(path);
+                if (image->width() == 0) continue;
+                buildClouds(*image);
+            } else {
+                shaderChanged = true;
+            }
+        }
+        if (shaderChanged && !compileShader()) {
+            std::cout << "Shader failed to compile" << std::endl;
         }
     }
 
     void onAnimate(double dt) override {
-        
+        reloadChangedAssets();
+        if (!culling) {
+            resend = resend || cloud != drawnCloud || drawnCulled;
+            drawnCloud = cloud;
+            drawnCulled = false;
+            return;
+        }
+        // minimised, the window can be 0 pixels high: nothing to cull for
+        if (height() <= 0) return;
+
+        ViewCamera cam = viewCamera(nav(), lens().fovy(), float(width()) / height(),
+                                    lens().near(), lens().far());
+        cullChunks(chunks[cloud], cam, lodDistance, visible);
+
+        // only gather when the view picks different chunks or strides
+        if (visible != drawnChunks || cloud != drawnCloud || !drawnCulled) {
+            gatherVisible(cloud->points, chunks[cloud], visible, visiblePoints);
+            resend = true;
+            drawnChunks = visible;
+            drawnCloud = cloud;
+            drawnCulled = true;
+        }
     }
 
     void onDraw(Graphics& g) override {
         g.clear(0.1);
         g.shader(shader);
         g.shader().uniform("pointSize", pointSize);
+        g.shader().uniform("vertexSize", 0.1f);
         g.blending(true);
         g.blendTrans();
         g.depthTesting(true);
-        g.draw(mesh);
+        if (resend && drawnCloud) {
+            gpu.upload(*drawnCloud, drawnCulled ? visiblePoints : drawnCloud->points);
+            resend = false;
+        }
+        gpu.draw(g);
     }
 
     bool onKeyDown(const Keyboard& k) override {
@@ -114,24 +169,29 @@ for (int y = 0; y < image.height(); ++y) {
         }
 
         if (k.key() == ' ') {
-            mesh.reset(); 
+            Mesh spaceMesh;
             for (int i = 0; i < 100; ++i) {
-                mesh.vertex(rvec());
-                mesh.color(rcolor());
-                mesh.texCoord(0.1, 0);
+                spaceMesh.vertex(rvec());
+                spaceMesh.color(rcolor());
             }
+            pack(spaceMesh, spaceCloud);
+            cloud = &spaceCloud;
+        }
+
+        if (k.key() == 'c') {
+            culling = !culling;
         }
 
         if (k.key() == '1') {
-            mesh = imageMesh; 
+            cloud = &imageCloud;
         }
 
         if (k.key() == '2') {
-            mesh = rgbCubeMesh;
+            cloud = &rgbCubeCloud;
         }
 
         if (k.key() == '4') {
-            mesh = randomMesh;
+            cloud = &randomCloud;
         }
         
         
@@ -142,14 +202,3 @@ for (int y = 0; y < image.height(); ++y) {
 
 int main() { MyApp().start(); }
 
-
-std::string slurp(std::string fileName) {
-    std::fstream file(fileName);
-    std::string returnValue = "";
-    while (file.good()) {
-      std::string line;
-      getline(file, line);
-      returnValue += line + "\n";
-    }
-    return returnValue;
-  }
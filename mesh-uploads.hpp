@@ -0,0 +1,147 @@
+#pragma once
+
+// upload only the parts of a VAOMesh that changed
+//
+//   VAOMesh mesh;  MeshUploads uploads;
+//   ... write mesh.colors()[10 .. 20) ...   uploads.mark(MeshUploads::Colors, 10, 20);
+//   onDraw:  uploads.upload(mesh);  g.draw(mesh);
+//
+// g.draw(Mesh&) sends every attribute of the mesh to the GPU on every call.
+// here each attribute keeps one dirty range (the hull of everything marked
+// since the last upload), a clean mesh costs nothing, and a dirty range
+// goes up with glBufferSubData. when the number of vertices, colours, ...
+// changed the buffers have to be reallocated, so that is a full update().
+// plan() says which it will be without touching the GPU.
+
+#include "al/graphics/al_VAOMesh.hpp"
+
+#include <algorithm>
+#include <cstddef>
+
+using namespace al;
+
+class MeshUploads {
+public:
+    enum Attribute { Positions, Colors, TexCoords, Normals, Attributes };
+
+    struct Range {
+        int begin = 0, end = 0;
+        bool empty() const { return begin >= end; }
+    };
+
+    // what upload() sends for a mesh: everything when the sizes changed,
+    // otherwise the dirty range of each attribute, cut to its size
+    struct Plan {
+        bool full = false;
+        Range ranges[Attributes];
+        int sizes[Attributes];
+        size_t bytes = 0;
+    };
+
+    // what the last upload() sent, for checking that idle frames are free
+    size_t uploadedBytes = 0;
+    int fullUpdates = 0;
+
+    void mark(Attribute a, int begin, int end) {
+        if (begin >= end) return;
+        Range& r = dirty[a];
+        if (r.empty()) {
+            r = {begin, end};
+        } else {
+            r.begin = std::min(r.begin, begin);
+            r.end = std::max(r.end, end);
+        }
+    }
+
+    void mark(Attribute a) { mark(a, 0, 1 << 30); }
+
+    void markAll() {
+        for (int a = 0; a < Attributes; ++a) mark(Attribute(a));
+    }
+
+    const Range& range(Attribute a) const { return dirty[a]; }
+
+    bool clean() const {
+        for (auto& r : dirty) {
+            if (!r.empty()) return false;
+        }
+        return true;
+    }
+
+    // decided on the CPU alone, so it can be checked without a window
+    Plan plan(const Mesh& mesh) const {
+        Plan p;
+        int sizes[Attributes] = {int(mesh.vertices().size()), int(mesh.colors().size()),
+                                 int(mesh.texCoord2s().size()), int(mesh.normals().size())};
+        std::copy(sizes, sizes + Attributes, p.sizes);
+        p.full = !std::equal(sizes, sizes + Attributes, uploaded);
+        for (int a = 0; a < Attributes; ++a) {
+            Range r = p.full ? Range{0, sizes[a]} : dirty[a];
+            r.end = std::min(r.end, sizes[a]);
+            if (r.empty()) continue;
+            p.ranges[a] = r;
+            p.bytes += (r.end - r.begin) * elementBytes(Attribute(a));
+        }
+        return p;
+    }
+
+    // after p went to the GPU: its sizes are what the buffers hold now, and
+    // nothing is dirty. upload() calls it; tests call it instead of upload()
+    void sent(const Plan& p) {
+        std::copy(p.sizes, p.sizes + Attributes, uploaded);
+        uploadedBytes = p.bytes;
+        fullUpdates += p.full;
+        for (auto& r : dirty) r = Range();
+    }
+
+    void upload(VAOMesh& mesh) {
+        Plan p = plan(mesh);
+        if (p.full) {
+            mesh.update();
+        } else {
+            for (int a = 0; a < Attributes; ++a) {
+                Range r = p.ranges[a];
+                if (r.empty()) continue;
+                size_t element = elementBytes(Attribute(a));
+                BufferObject& b = buffer(mesh, Attribute(a));
+                b.bind();
+                b.subdata(r.begin * element, (r.end - r.begin) * element, data(mesh, Attribute(a), r.begin));
+            }
+        }
+        sent(p);
+    }
+
+    static size_t elementBytes(Attribute a) {
+        const size_t bytes[Attributes] = {sizeof(Vec3f), sizeof(Color), sizeof(Vec2f), sizeof(Vec3f)};
+        return bytes[a];
+    }
+
+private:
+    Range dirty[Attributes];
+    int uploaded[Attributes] = {-1, -1, -1, -1};
+
+    // the only code that reaches into VAOMesh. allolib has no API for
+    // updating part of a mesh, so this relies on the layout of
+    // al_VAOMesh.hpp on allolib's main branch as of 2023: a public
+    // std::shared_ptr<VAOWrapper> vaoWrapper whose positionAtt, colorAtt,
+    // texcoord2dAtt and normalAtt each hold the BufferObject buffer that
+    // update() fills. a newer allolib that moves them needs changes here only
+    static BufferObject& buffer(VAOMesh& mesh, Attribute a) {
+        auto& vao = *mesh.vaoWrapper;
+        switch (a) {
+            case Positions: return vao.positionAtt.buffer;
+            case Colors: return vao.colorAtt.buffer;
+            case TexCoords: return vao.texcoord2dAtt.buffer;
+            default: return vao.normalAtt.buffer;
+        }
+    }
+
+    static void* data(Mesh& mesh, Attribute a, int i) {
+        switch (a) {
+            case Positions: return &mesh.vertices()[i];
+            case Colors: return &mesh.colors()[i];
+            case TexCoords: return &mesh.texCoord2s()[i];
+            default: return &mesh.normals()[i];
+        }
+    }
+};
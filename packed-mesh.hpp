@@ -0,0 +1,139 @@
+#pragma once
+
+// packed points on the GPU as they are in memory
+//
+//   PackedMesh gpu;
+//   onDraw:  gpu.upload(cloud);                    // only when it changed
+//            g.shader(shader);  gpu.draw(g);
+//
+// a PackedPoint goes up as it is, 10 bytes: the 16-bit position as a
+// normalised GL_UNSIGNED_SHORT attribute, the colour as normalised
+// GL_UNSIGNED_BYTE. point-vertex.glsl scales the position back with the
+// cloud's bounds (boundsMin, boundsSize), which draw() sets as uniforms, so
+// nothing is ever unpacked to floats on the CPU. a second buffer holds the
+// same points in another layout (uploadTarget); the shader moves each point
+// towards it by the uniform "transition", so a transition between layouts
+// uploads nothing while it runs, and swap() makes the target the points
+// drawn when it is over. the colour always comes from the points drawn.
+
+#include "al/graphics/al_BufferObject.hpp"
+#include "al/graphics/al_Graphics.hpp"
+#include "al/graphics/al_OpenGL.hpp"
+#include "al/graphics/al_VAO.hpp"
+#include "packed-points.hpp"
+
+#include <cstddef>
+#include <vector>
+
+using namespace al;
+
+class PackedMesh {
+public:
+    // attribute locations, as point-vertex.glsl declares them
+    enum Location { Position = 0, Colour = 1, TargetPosition = 2 };
+
+    // what uploads sent so far
+    size_t uploadedBytes = 0;
+
+    int size() const { return buffers[shown].count; }
+
+    // points of cloud (all of them, or a gathered subset) as the ones drawn
+    void upload(const PackedCloud& cloud, const std::vector<PackedPoint>& points) {
+        send(buffers[shown], cloud, points);
+    }
+    void upload(const PackedCloud& cloud) { upload(cloud, cloud.points); }
+
+    // where transition moves the points drawn: the same points, in the
+    // same order, of another layout
+    void uploadTarget(const PackedCloud& cloud, const std::vector<PackedPoint>& points) {
+        send(buffers[1 - shown], cloud, points);
+    }
+    void uploadTarget(const PackedCloud& cloud) { uploadTarget(cloud, cloud.points); }
+
+    // the target becomes the points drawn, without uploading anything
+    void swap() {
+        shown = 1 - shown;
+        pointed = false;
+    }
+
+    // t is how far the points are moved towards the target, 0 to 1; call
+    // after g.shader(...)
+    void draw(Graphics& g, float t = 0) {
+        if (size() == 0) return;
+        const Buffer& from = buffers[shown];
+        const Buffer& to = buffers[1 - shown];
+        bool moving = t > 0 && to.count == from.count;
+        g.shader().uniform("boundsMin", from.min);
+        g.shader().uniform("boundsSize", from.size);
+        g.shader().uniform("targetMin", to.min);
+        g.shader().uniform("targetSize", to.size);
+        g.shader().uniform("transition", moving ? t : 0.0f);
+        g.update();  // the matrices, as g.draw(mesh) would send them
+        if (!pointed) point();
+        vao.bind();
+        glDrawArrays(GL_POINTS, 0, size());
+        vao.unbind();
+    }
+
+private:
+    struct Buffer {
+        BufferObject buffer;
+        int count = 0, capacity = 0;  // in points
+        Vec3f min, size;              // of the cloud the points came from
+    };
+
+    VAO vao;
+    Buffer buffers[2];
+    int shown = 0;         // the buffer drawn; the other is the target
+    bool pointed = false;  // attributes set up for the buffers as they are
+
+    void create() {
+        vao.create();
+        for (auto& b : buffers) {
+            b.buffer.bufferType(GL_ARRAY_BUFFER);
+            b.buffer.usage(GL_DYNAMIC_DRAW);
+            b.buffer.create();
+        }
+    }
+
+    // a larger cloud reallocates the buffer (glBufferData), a smaller or
+    // equal one is written over (glBufferSubData)
+    void send(Buffer& b, const PackedCloud& cloud, const std::vector<PackedPoint>& points) {
+        if (!vao.created()) create();
+        b.min = cloud.min;
+        b.size = cloud.max - cloud.min;
+        b.count = points.size();
+        size_t bytes = points.size() * sizeof(PackedPoint);
+        b.buffer.bind();
+        if (b.count > b.capacity) {
+            b.buffer.data(bytes, points.data());
+            b.capacity = b.count;
+            pointed = false;
+        } else if (bytes > 0) {
+            b.buffer.subdata(0, bytes, points.data());
+        }
+        b.buffer.unbind();
+        uploadedBytes += bytes;
+    }
+
+    void point() {
+        const GLsizei stride = sizeof(PackedPoint);
+        auto at = [](size_t offset) { return reinterpret_cast<void const*>(offset); };
+        vao.bind();
+        vao.enableAttrib(Position);
+        vao.attribPointer(Position, buffers[shown].buffer, 3, GL_UNSIGNED_SHORT, GL_TRUE, stride,
+                          at(offsetof(PackedPoint, x)));
+        vao.enableAttrib(Colour);
+        vao.attribPointer(Colour, buffers[shown].buffer, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride,
+                          at(offsetof(PackedPoint, r)));
+        if (buffers[1 - shown].capacity > 0) {
+            vao.enableAttrib(TargetPosition);
+            vao.attribPointer(TargetPosition, buffers[1 - shown].buffer, 3, GL_UNSIGNED_SHORT, GL_TRUE, stride,
+                              at(offsetof(PackedPoint, x)));
+        } else {
+            vao.disableAttrib(TargetPosition);
+        }
+        vao.unbind();
+        pointed = true;
+    }
+};
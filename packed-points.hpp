@@ -0,0 +1,98 @@
+#pragma once
+
+// compact storage for image point clouds
+//
+// a point is 16-bit positions normalised to the cloud's bounding box plus
+// RGBA8 colour: 10 bytes instead of a Vec3f + Color + texCoord (36 bytes).
+// the point size is the same for every point, so it is a shader uniform
+// ("vertexSize") and not stored at all. convert to a Mesh only at the
+// boundary, when something has to be drawn.
+
+#include "al/graphics/al_Mesh.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+using namespace al;
+
+struct PackedPoint {
+    uint16_t x, y, z;
+    uint8_t r, g, b, a;
+};
+
+struct PackedCloud {
+    Vec3f min, max;  // quantisation bounds
+    Vec3f step;      // size of one position unit on each axis
+    std::vector<PackedPoint> points;
+
+    int size() const { return points.size(); }
+    size_t bytes() const { return points.size() * sizeof(PackedPoint); }
+
+    void pack(const std::vector<Vec3f>& positions, const std::vector<Color>& colors) {
+        points.resize(positions.size());
+        if (positions.empty()) return;
+
+        min = max = positions[0];
+        for (auto& p : positions) {
+            for (int k = 0; k < 3; ++k) {
+                min[k] = std::min(min[k], p[k]);
+                max[k] = std::max(max[k], p[k]);
+            }
+        }
+
+        Vec3f toUnits;
+        for (int k = 0; k < 3; ++k) {
+            float extent = max[k] - min[k];
+            step[k] = extent / 65535.0f;
+            toUnits[k] = extent > 0 ? 65535.0f / extent : 0.0f;
+        }
+
+        auto to8 = [](float c) { return uint8_t(std::min(std::max(c, 0.0f), 1.0f) * 255.0f + 0.5f); };
+        for (int i = 0; i < points.size(); ++i) {
+            Vec3f q = positions[i] - min;
+            points[i].x = uint16_t(q[0] * toUnits[0] + 0.5f);
+            points[i].y = uint16_t(q[1] * toUnits[1] + 0.5f);
+            points[i].z = uint16_t(q[2] * toUnits[2] + 0.5f);
+            const Color& c = colors[i];
+            points[i].r = to8(c.r);
+            points[i].g = to8(c.g);
+            points[i].b = to8(c.b);
+            points[i].a = to8(c.a);
+        }
+    }
+
+    Vec3f position(int i) const {
+        const PackedPoint& p = points[i];
+        return Vec3f(min[0] + p.x * step[0], min[1] + p.y * step[1], min[2] + p.z * step[2]);
+    }
+
+    Color color(int i) const {
+        const PackedPoint& p = points[i];
+        return Color(p.r / 255.0f, p.g / 255.0f, p.b / 255.0f, p.a / 255.0f);
+    }
+
+    std::vector<Vec3f> positions() const {
+        std::vector<Vec3f> out(points.size());
+        for (int i = 0; i < points.size(); ++i) out[i] = position(i);
+        return out;
+    }
+
+    void fromMesh(const Mesh& mesh) { pack(mesh.vertices(), mesh.colors()); }
+
+    void toMesh(Mesh& mesh) const {
+        mesh.reset();
+        mesh.primitive(Mesh::POINTS);
+        mesh.vertices().reserve(points.size());
+        mesh.colors().reserve(points.size());
+        for (int i = 0; i < points.size(); ++i) {
+            mesh.vertex(position(i));
+            mesh.color(color(i));
+        }
+    }
+};
+
+// what the same points cost as a Mesh with positions, colours and texCoords
+inline size_t meshBytes(int points) {
+    return size_t(points) * (sizeof(Vec3f) + sizeof(Color) + sizeof(Vec2f));
+}
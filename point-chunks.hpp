@@ -0,0 +1,178 @@
+#pragma once
+
+// chunked view-frustum culling and distance LOD for point clouds
+//
+// a chunk is a run of consecutive points with its own bounding box. the
+// runs are only tight in space if the points are stored in a space-filling
+// curve order first (see point-order.hpp). nothing here touches a window
+// or the GPU, so a synthetic ViewCamera is enough to exercise it.
+
+#include "al/graphics/al_Mesh.hpp"
+#include "al/spatial/al_Pose.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+using namespace al;
+
+struct PointChunk {
+    int begin, end;  // points [begin, end)
+    Vec3f min, max;
+};
+
+// which chunk to draw and how many points to skip between drawn points
+struct VisibleChunk {
+    int chunk;
+    int stride;
+    bool operator==(const VisibleChunk& other) const {
+        return chunk == other.chunk && stride == other.stride;
+    }
+};
+
+inline void updateChunkBounds(std::vector<PointChunk>& chunks, const std::vector<Vec3f>& positions) {
+    for (auto& c : chunks) {
+        c.min = c.max = positions[c.begin];
+        for (int i = c.begin; i < c.end; ++i) {
+            for (int k = 0; k < 3; ++k) {
+                c.min[k] = std::min(c.min[k], positions[i][k]);
+                c.max[k] = std::max(c.max[k], positions[i][k]);
+            }
+        }
+    }
+}
+
+// the boxes of chunks whose points move in straight lines from one layout
+// to another: at t each point is the same mix of a point in its from box
+// and one in its to box, so it is inside the mix of the two boxes and no
+// point has to be looked at
+inline void lerpChunkBounds(const std::vector<PointChunk>& from, const std::vector<PointChunk>& to, float t,
+                            std::vector<PointChunk>& out) {
+    out = from;
+    for (int c = 0; c < out.size(); ++c) {
+        out[c].min = from[c].min * (1 - t) + to[c].min * t;
+        out[c].max = from[c].max * (1 - t) + to[c].max * t;
+    }
+}
+
+inline std::vector<PointChunk> makeChunks(const std::vector<Vec3f>& positions, int chunkSize = 4096) {
+    std::vector<PointChunk> chunks;
+    for (int begin = 0; begin < positions.size(); begin += chunkSize) {
+        int end = std::min(begin + chunkSize, int(positions.size()));
+        chunks.push_back({begin, end, Vec3f(), Vec3f()});
+    }
+    updateChunkBounds(chunks, positions);
+    return chunks;
+}
+
+// everything culling needs to know about the viewer
+struct ViewCamera {
+    Vec3f pos;
+    Vec3f forward, up, right;  // unit vectors
+    float fovy = 60;           // degrees
+    float aspect = 1;
+    float nearClip = 0.1;
+    float farClip = 100;
+};
+
+inline ViewCamera viewCamera(const Pose& pose, float fovy, float aspect, float nearClip, float farClip) {
+    ViewCamera cam;
+    cam.pos = Vec3f(pose.pos());
+    cam.forward = Vec3f(pose.uf());
+    cam.up = Vec3f(pose.uu());
+    cam.right = Vec3f(pose.ur());
+    cam.fovy = fovy;
+    cam.aspect = aspect;
+    cam.nearClip = nearClip;
+    cam.farClip = farClip;
+    return cam;
+}
+
+// six planes with normals pointing into the visible volume
+struct Frustum {
+    Vec3f normal[6];
+    float offset[6];
+
+    bool intersects(const Vec3f& min, const Vec3f& max) const {
+        for (int p = 0; p < 6; ++p) {
+            // the corner of the box furthest along the plane normal
+            Vec3f corner(normal[p][0] >= 0 ? max[0] : min[0],
+                         normal[p][1] >= 0 ? max[1] : min[1],
+                         normal[p][2] >= 0 ? max[2] : min[2]);
+            if (normal[p].dot(corner) + offset[p] < 0) return false;
+        }
+        return true;
+    }
+};
+
+inline Frustum makeFrustum(const ViewCamera& cam) {
+    float tanY = std::tan(cam.fovy * 0.5f * float(M_PI) / 180.0f);
+    float tanX = tanY * cam.aspect;
+
+    Frustum f;
+    f.normal[0] = cam.forward;                              // near
+    f.normal[1] = -cam.forward;                             // far
+    f.normal[2] = (cam.forward * tanX + cam.right).normalize();  // left
+    f.normal[3] = (cam.forward * tanX - cam.right).normalize();  // right
+    f.normal[4] = (cam.forward * tanY + cam.up).normalize();     // bottom
+    f.normal[5] = (cam.forward * tanY - cam.up).normalize();     // top
+    for (int p = 0; p < 6; ++p) {
+        f.offset[p] = -f.normal[p].dot(cam.pos);
+    }
+    f.offset[0] -= cam.nearClip;
+    f.offset[1] += cam.farClip;
+    return f;
+}
+
+// full detail inside lodDistance, then every 2nd point out to twice that,
+// every 4th out to four times that, ... never sparser than maxStride
+inline int lodStride(float distance, float lodDistance, int maxStride = 16) {
+    int stride = 1;
+    float limit = lodDistance;
+    while (distance > limit && stride < maxStride) {
+        stride *= 2;
+        limit *= 2;
+    }
+    return stride;
+}
+
+inline void cullChunks(const std::vector<PointChunk>& chunks, const ViewCamera& cam,
+                       float lodDistance, std::vector<VisibleChunk>& visible) {
+    Frustum frustum = makeFrustum(cam);
+    visible.clear();
+    for (int c = 0; c < chunks.size(); ++c) {
+        if (!frustum.intersects(chunks[c].min, chunks[c].max)) continue;
+
+        // distance to the nearest point of the box
+        Vec3f nearest;
+        for (int k = 0; k < 3; ++k) {
+            nearest[k] = std::min(std::max(cam.pos[k], chunks[c].min[k]), chunks[c].max[k]);
+        }
+        visible.push_back({c, lodStride((nearest - cam.pos).mag(), lodDistance)});
+    }
+}
+
+// copy the visible points of source into out
+inline void gatherVisible(const Mesh& source, const std::vector<PointChunk>& chunks,
+                          const std::vector<VisibleChunk>& visible, Mesh& out) {
+    out.reset();
+    out.primitive(Mesh::POINTS);
+    for (auto& v : visible) {
+        const PointChunk& c = chunks[v.chunk];
+        for (int i = c.begin; i < c.end; i += v.stride) {
+            out.vertex(source.vertices()[i]);
+            out.color(source.colors()[i]);
+        }
+    }
+}
+
+// the same for points stored one element each, such as PackedPoint
+template <class T>
+void gatherVisible(const std::vector<T>& source, const std::vector<PointChunk>& chunks,
+                   const std::vector<VisibleChunk>& visible, std::vector<T>& out) {
+    out.clear();
+    for (auto& v : visible) {
+        const PointChunk& c = chunks[v.chunk];
+        for (int i = c.begin; i < c.end; i += v.stride) out.push_back(source[i]);
+    }
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+// building the image point clouds, pulled out of main.cpp and
+// revisedmain.cpp so they can also run outside the apps (see bench/).
+// pixels are the RGBA8 array of an al::Image, row by row.
+
+#include "al/graphics/al_Mesh.hpp"
+#include "al/math/al_Random.hpp"
+#include "colorspace.hpp"
+#include "packed-points.hpp"
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+using namespace al;
+
+// main.cpp: one read of each pixel fills every layout
+inline void fillPointClouds(const uint8_t* pixels, int w, int h,
+                            Mesh& imageMesh, Mesh& rgbCubeMesh, Mesh& randomMesh) {
+    int count = w * h;
+    for (Mesh* m : {&imageMesh, &rgbCubeMesh, &randomMesh}) {
+        m->reset();
+        m->primitive(Mesh::POINTS);
+        m->vertices().reserve(count);
+        m->colors().reserve(count);
+    }
+
+    for (int y = 0; y < h; ++y) {
+        for (int x = 0; x < w; ++x) {
+            const uint8_t* pixel = pixels + 4 * (y * w + x);
+            float r = pixel[0] / 255.0f;
+            float g = pixel[1] / 255.0f;
+            float b = pixel[2] / 255.0f;
+            Color c(r, g, b);
+
+            imageMesh.vertex(float(x) / w, float(y) / h, 0);
+            imageMesh.color(c);
+
+            rgbCubeMesh.vertex(r, g, b);
+            rgbCubeMesh.color(c);
+
+            randomMesh.vertex(rnd::uniformS(), rnd::uniformS(), rnd::uniformS());
+            randomMesh.color(c);
+        }
+    }
+}
+
+// revisedmain.cpp: "image", "mine" and every colorspace::targets() layout
+inline void buildLayouts(const uint8_t* pixels, int w, int h,
+                         std::map<std::string, PackedCloud>& layouts) {
+    int n = w * h;
+
+    // one pass over the pixels into float channels; the colour-space
+    // layouts are then converted a whole array at a time
+    colorspace::RGBArrays rgb;
+    colorspace::unpackRGB8(pixels, n, 4, rgb);
+
+    std::vector<Color> colors(n);
+    std::vector<Vec3f> imagePositions(n), myPositions(n);
+    for (int i = 0; i < n; ++i) {
+        colors[i] = Color(rgb.r[i], rgb.g[i], rgb.b[i]);
+        imagePositions[i] = Vec3f(float(i % w) / w, float(i / w) / h, 0.0f);
+        myPositions[i] = Vec3f(rnd::uniformS(), rnd::uniformS(), rnd::uniformS());
+    }
+    layouts["image"].pack(imagePositions, colors);
+    layouts["mine"].pack(myPositions, colors);
+
+    // "rgb", "hsv", "lab", ... whatever colorspace::targets() knows about
+    std::vector<Vec3f> positions(n);
+    for (auto& target : colorspace::targets()) {
+        target.second(rgb, positions.data());
+        layouts[target.first].pack(positions, colors);
+    }
+}
+
+// one frame of a transition between two layouts of the same size
+inline void lerpLayouts(const PackedCloud& from, const PackedCloud& to, float t,
+                        std::vector<Vec3f>& positions) {
+    for (int i = 0; i < positions.size(); ++i) {
+        positions[i] = lerp(from.position(i), to.position(i), t);
+    }
+}
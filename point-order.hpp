@@ -0,0 +1,103 @@
+#pragma once
+
+// space-filling-curve ordering of point clouds
+//
+// points that are close in space end up close in memory. the order is a
+// list of indices, so one order can be applied to several arrays (or
+// several layouts) and index i still means the same pixel in all of them.
+
+#include "al/math/al_Vec.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <numeric>
+#include <vector>
+
+using namespace al;
+
+enum class Curve { Morton, Hilbert };
+
+// spread the low 10 bits of v out to every third bit
+inline uint32_t spreadBits(uint32_t v) {
+    v &= 0x3ff;
+    v = (v | (v << 16)) & 0x030000ff;
+    v = (v | (v << 8)) & 0x0300f00f;
+    v = (v | (v << 4)) & 0x030c30c3;
+    v = (v | (v << 2)) & 0x09249249;
+    return v;
+}
+
+// 30-bit Z-order key of three 10-bit coordinates
+inline uint32_t morton3(uint32_t x, uint32_t y, uint32_t z) {
+    return (spreadBits(x) << 2) | (spreadBits(y) << 1) | spreadBits(z);
+}
+
+// 30-bit Hilbert key of three 10-bit coordinates (Skilling's transform)
+inline uint32_t hilbert3(uint32_t x, uint32_t y, uint32_t z) {
+    uint32_t X[3] = {x, y, z};
+    const uint32_t M = 1u << 9;
+
+    for (uint32_t Q = M; Q > 1; Q >>= 1) {
+        uint32_t P = Q - 1;
+        for (int i = 0; i < 3; ++i) {
+            if (X[i] & Q) {
+                X[0] ^= P;
+            } else {
+                uint32_t t = (X[0] ^ X[i]) & P;
+                X[0] ^= t;
+                X[i] ^= t;
+            }
+        }
+    }
+
+    X[1] ^= X[0];
+    X[2] ^= X[1];
+    uint32_t t = 0;
+    for (uint32_t Q = M; Q > 1; Q >>= 1) {
+        if (X[2] & Q) t ^= Q - 1;
+    }
+    for (int i = 0; i < 3; ++i) X[i] ^= t;
+
+    return morton3(X[0], X[1], X[2]);
+}
+
+// order[k] is the index of the point that should be stored k-th
+inline std::vector<int> spaceFillingOrder(const std::vector<Vec3f>& positions,
+                                          Curve curve = Curve::Hilbert) {
+    int n = positions.size();
+    std::vector<int> order(n);
+    std::iota(order.begin(), order.end(), 0);
+    if (n == 0) return order;
+
+    Vec3f lo = positions[0], hi = positions[0];
+    for (auto& p : positions) {
+        for (int k = 0; k < 3; ++k) {
+            lo[k] = std::min(lo[k], p[k]);
+            hi[k] = std::max(hi[k], p[k]);
+        }
+    }
+    Vec3f scale;
+    for (int k = 0; k < 3; ++k) {
+        scale[k] = hi[k] > lo[k] ? 1023.0f / (hi[k] - lo[k]) : 0.0f;
+    }
+
+    std::vector<uint32_t> keys(n);
+    for (int i = 0; i < n; ++i) {
+        Vec3f q = positions[i] - lo;
+        uint32_t x = q[0] * scale[0], y = q[1] * scale[1], z = q[2] * scale[2];
+        keys[i] = curve == Curve::Morton ? morton3(x, y, z) : hilbert3(x, y, z);
+    }
+
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return keys[a] < keys[b]; });
+    return order;
+}
+
+// data[k] = old data[order[k]]
+template <typename T>
+void applyOrder(std::vector<T>& data, const std::vector<int>& order) {
+    std::vector<T> sorted(order.size());
+    for (int k = 0; k < order.size(); ++k) {
+        sorted[k] = data[order[k]];
+    }
+    data.swap(sorted);
+}
@@ -2,11 +2,23 @@
 
 layout(location = 0) in vec3 vertexPosition;
 layout(location = 1) in vec4 vertexColor;
-layout(location = 2) in vec2 vertexSize;
-// vertexSize is 2D texture cordinate, but we only use the x
+layout(location = 2) in vec3 targetPosition;
 
 uniform mat4 al_ModelViewMatrix;
 uniform mat4 al_ProjectionMatrix;
+uniform float vertexSize;
+// vertexSize is the same for every point, so it is a uniform and not a
+// per-vertex texture cordinate
+
+// packed points (packed-mesh.hpp) arrive normalised to 0..1 and are scaled
+// back with the bounds of their cloud; a float Mesh keeps the defaults
+uniform vec3 boundsMin = vec3(0.0);
+uniform vec3 boundsSize = vec3(1.0);
+// a transition between layouts: each point moves this far towards its
+// position in the target layout, scaled with that layout's bounds
+uniform vec3 targetMin = vec3(0.0);
+uniform vec3 targetSize = vec3(1.0);
+uniform float transition = 0.0;
 
 out Vertex {
   vec4 color;
@@ -14,7 +26,9 @@ out Vertex {
 } vertex;
 
 void main() {
-  gl_Position = al_ModelViewMatrix * vec4(vertexPosition, 1.0);
+  vec3 position = boundsMin + vertexPosition * boundsSize;
+  position = mix(position, targetMin + targetPosition * targetSize, transition);
+  gl_Position = al_ModelViewMatrix * vec4(position, 1.0);
   vertex.color = vertexColor;
-  vertex.size = vertexSize.x;
+  vertex.size = vertexSize;
 }
\ No newline at end of file
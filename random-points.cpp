@@ -1,37 +1,55 @@
 #include "al/app/al_App.hpp"
 #include "al/math/al_Random.hpp"
+#include "asset-loader.hpp"
 using namespace al;
-#include <fstream> // for slurp()
-#include <string> // for slurp()
+#include <string>
 
 Vec3f rvec() { return Vec3f(rnd::uniformS(), rnd::uniformS(), rnd::uniformS()); }
 RGB rcolor() { return RGB(rnd::uniform(), rnd::uniform(), rnd::uniform()); }
 
-std::string slurp(std::string fileName); // only a declaration
-
 class MyApp : public App {
     
     Mesh mesh;
+    AssetLoader assets;
     ShaderProgram shader;
 
+    void onInit() override {
+        for (auto path : {"../point-vertex.glsl", "../point-fragment.glsl", "../point-geometry.glsl"}) {
+            assets.prefetch(path);
+            assets.watch(path);
+        }
+    }
+
+    bool compileShader() {
+        return assets.compile(shader, "../point-vertex.glsl", "../point-fragment.glsl",
+                              "../point-geometry.glsl");
+    }
+
     void onCreate() override {
         mesh.primitive(Mesh::POINTS);
         for (int i = 0; i < 100; ++i) {
             mesh.vertex(rvec());
             mesh.color(rcolor());
-            mesh.texCoord(0.1, 0);
         }
     
-        if (! shader.compile(slurp("../point-vertex.glsl"), slurp("../point-fragment.glsl"), slurp("../point-geometry.glsl"))) {
+        if (! compileShader()) {
             printf("Shader failed to compile\n");
             exit(1);
         }
     }
 
+    void onAnimate(double dt) override {
+        // edited shaders are picked up without restarting
+        if (!assets.changed().empty() && !compileShader()) {
+            printf("Shader failed to compile\n");
+        }
+    }
+
     void onDraw(Graphics& g) override {
         g.clear(0.1);
         g.shader(shader);
         g.shader().uniform("pointSize", 0.1);
+        g.shader().uniform("vertexSize", 0.1f);
         g.blending(true);
         g.blendTrans();
         g.depthTesting(true);
@@ -49,7 +67,6 @@ class MyApp : public App {
             for (int i = 0; i < 100; ++i) {
                 mesh.vertex(rvec());
                 mesh.color(rcolor());
-                mesh.texCoord(0.1, 0);
             }
         }
 
@@ -58,14 +75,3 @@ class MyApp : public App {
 };
 int main() { MyApp().start(); }
 
-
-std::string slurp(std::string fileName) {
-    std::fstream file(fileName);
-    std::string returnValue = "";
-    while (file.good()) {
-      std::string line;
-      getline(file, line);
-      returnValue += line + "\n";
-    }
-    return returnValue;
-  }
\ No newline at end of file
@@ -2,11 +2,20 @@
 #include "al/graphics/al_Image.hpp"
 #include "al/app/al_GUIDomain.hpp"
 #include "al/math/al_Random.hpp"
-
-#include <fstream>
+#include "asset-loader.hpp"
+#include "colorspace.hpp"
+#include "frame-budget.hpp"
+#include "packed-mesh.hpp"
+#include "packed-points.hpp"
+#include "point-chunks.hpp"
+#include "point-layouts.hpp"
+#include "point-order.hpp"
+#include "scenario.hpp"
+
+#include <chrono>
 #include <string>
 #include <map>
-#include <sstream>
+#include <random>
 
 using namespace al;
 
@@ -16,152 +25,363 @@ RGB randColor() { return RGB(rnd::uniform(), rnd::uniform(), rnd::uniform()); }
 
 
 
-// used a llm for this --> 
-
-Vec3f hsvToCylindrical(float h, float s, float v) {
-    float theta = h * M_2PI;
-    return Vec3f(cos(theta) * s, v, sin(theta) * s);
-}
-
-std::string slurp(const std::string& filename) {  // only a declaration
-    std::ifstream f(filename);
-    std::stringstream buffer;
-    buffer << f.rdbuf();
-    return buffer.str();
-}
-
-// data container for layouts
-struct Layout {
-    std::vector<Vec3f> positions;
-    std::vector<Color> colors;
-};
+// data container for layouts: 16-bit positions and RGBA8 colours, on the
+// CPU and on the GPU alike
+using Layout = PackedCloud;
 
 class MyApp : public App {
-    Mesh displayMesh;
+public:
+    AssetLoader assets;
     ShaderProgram shader;
     Parameter pointSize{"pointSize", 0.004, 0.0005, 0.015};
-
-    Layout currentLayout, nextLayout;
-    std::vector<Vec3f> interpolated;
+    Parameter lodDistance{"lodDistance", 3.0, 0.1, 20.0};
+
+    // adaptive quality: moves lodDistance to fit the frame budget
+    FrameBudget frameBudget;
+
+    // view-frustum culling: chunks are runs of the shared point order, only
+    // the ones in view are copied to shownPoints (and targetPoints). their
+    // boxes come from each layout once (chunksOf) and are mixed while a
+    // transition runs
+    bool culling = true;
+    bool regather = true;
+    std::map<const Layout*, std::vector<PointChunk>> chunksOf;
+    std::vector<PointChunk> chunks;
+    std::vector<VisibleChunk> visible, drawnChunks;
+    std::vector<PackedPoint> shownPoints, targetPoints;
+
+    // the layouts go to the GPU packed and the shader moves the points
+    // (packed-mesh.hpp): currentLayout when it changes, nextLayout when a
+    // transition starts, and only a uniform while it runs
+    PackedMesh gpu;
+    bool resendShown = true, resendTarget = false;
+
+    const Layout* currentLayout = nullptr;
+    const Layout* nextLayout = nullptr;
+    Layout spaceLayout;  // the random points from the space key
 
     float transitionTime = 1.0;
     float elapsed = 0.0;
+    float t = 0.0;  // how far the transition is
     bool transitioning = false;
 
     std::map<std::string, Layout> layouts;
 
+    // every layout is stored in one shared space-filling-curve order, so
+    // index i is the same pixel everywhere but neighbours sit together
+    bool reorder = true;
+    Curve curve = Curve::Hilbert;
+    std::string orderBy = "rgb";  // layout whose space decides the order
+    std::vector<int> order;
+
+    // 'r' starts over from a new seed and captures every key to
+    // revised.scenario until pressed again; "./revisedmain replay
+    // revised.scenario" runs it again without a window
+    ScenarioRecorder capture;
+    std::string mode;
+
     void onInit() override {
         auto gui = GUIDomain::enableGUI(defaultWindowDomain())->newGUI();
         gui.add(pointSize);  // add parameter to GUI
+        gui.add(lodDistance);
+        gui.add(frameBudget.budget);
+        gui.add(frameBudget.measured);
+        gui.add(frameBudget.adaptive);
+
+        // read the shaders and decode the image while the window opens
+        for (auto path : {"../point-vertex.glsl", "../point-fragment.glsl", "../point-geometry.glsl"}) {
+            assets.prefetch(path);
+            assets.watch(path);
+        }
+        assets.prefetchImage("../rainbow.jpg");
+        assets.watch("../rainbow.jpg");
     }
 
-    void loadLayouts(const Image& img) {
-        Layout imageLayout, rgbLayout, hsvLayout, myLayout;
-
-        int w = img.width();
-        int h = img.height();
-
-        for (int y = 0; y < h; ++y) {
-            for (int x = 0; x < w; ++x) {
-                auto px = img.at(x, y);
-                float r = px.r / 255.0f;
-                float g = px.g / 255.0f;
-                float b = px.b / 255.0f;
-
-                Vec3f posNorm = Vec3f(float(x) / w, float(y) / h, 0.0f);
-                Color color(r, g, b);
-                HSV hsv(color);
-
-                imageLayout.positions.push_back(posNorm);
-                rgbLayout.positions.push_back(Vec3f(r, g, b));
-                hsvLayout.positions.push_back(hsvToCylindrical(hsv.h, hsv.s, hsv.v));
-                myLayout.positions.push_back(randVec3());
-
-                imageLayout.colors.push_back(color);
-                rgbLayout.colors.push_back(color);
-                hsvLayout.colors.push_back(color);
-                myLayout.colors.push_back(color);
+    bool compileShader() {
+        return assets.compile(shader, "../point-vertex.glsl", "../point-fragment.glsl",
+                              "../point-geometry.glsl");
+    }
+
+    // picks up edited shaders and images without restarting
+    void reloadChangedAssets() {
+        bool shaderChanged = false;
+        for (auto& path : assets.changed()) {
+            if (path == "../rainbow.jpg") {
+                auto img = assets.image(path);
+                if (img->width() == 0) continue;
+                transitioning = false;
+                loadLayouts(*img);
+            } else {
+                shaderChanged = true;
             }
         }
+        if (shaderChanged && !compileShader()) {
+            std::cerr << "Shader failed to compile.\n";
+        }
+    }
 
-        // sets up mesh and initial data
-        currentLayout = imageLayout;
-        nextLayout = imageLayout;
-        interpolated = imageLayout.positions;
+    void loadLayouts(const Image& img) {
+        buildLayouts(img.array().data(), img.width(), img.height(), layouts);
+
+        if (reorder) {
+            order = spaceFillingOrder(layouts[orderBy].positions(), curve);
+            for (auto& layout : layouts) {
+                applyOrder(layout.second.points, order);
+            }
+        }
 
-        displayMesh.primitive(Mesh::POINTS);
-        for (int i = 0; i < interpolated.size(); ++i) {
-            displayMesh.vertex(interpolated[i]);
-            displayMesh.color(currentLayout.colors[i]);
-            displayMesh.texCoord(0.1, 0);
+        chunksOf.clear();
+        for (auto& layout : layouts) {
+            std::cout << layout.first << ": " << layout.second.bytes() / 1024
+                      << " KiB packed (" << meshBytes(layout.second.size()) / 1024 << " KiB as a Mesh)"
+                      << std::endl;
+            chunksOf[&layout.second] = makeChunks(layout.second.positions());
         }
 
-        // stores layouts
-        layouts["image"] = imageLayout;
-        layouts["rgb"] = rgbLayout;
-        layouts["hsv"] = hsvLayout;
-        layouts["mine"] = myLayout;
+        show(layouts["image"]);
+    }
+
+    // draws layout from now on, without a transition
+    void show(const Layout& layout) {
+        currentLayout = nextLayout = &layout;
+        if (!chunksOf.count(currentLayout)) chunksOf[currentLayout] = makeChunks(currentLayout->positions());
+        chunks = chunksOf[currentLayout];
+        transitioning = false;
+        t = 0;
+        resendShown = true;
+        regather = true;
     }
 
     void startTransition(const std::string& name) {
         if (!layouts.count(name)) return;
 
-        nextLayout = layouts[name];
-
-        for (int i = 0; i < nextLayout.colors.size(); ++i) {
-            displayMesh.colors()[i] = nextLayout.colors[i];
+        // nothing to interpolate between clouds of different sizes
+        if (layouts[name].size() != currentLayout->size()) {
+            show(layouts[name]);
+            return;
         }
 
+        // the points keep their colours: every layout of the image has the
+        // same colour at the same index
+        nextLayout = &layouts[name];
+        resendTarget = true;
+        regather = true;
+
         elapsed = 0.0;
+        t = 0.0;
         transitioning = true;
     }
 
-    void onCreate() override {
-        Image img("../rainbow.jpg");
-        if (img.width() == 0) {
-            std::cerr << "Image failed to load.\n";
-            exit(1);
+    // times one transition sweep and a block-culling pass over the current
+    // layout pair, once in raster order and once in the curve order
+    void benchmarkOrder() {
+        if (order.empty() || currentLayout->size() != order.size()) return;
+
+        std::vector<int> inverse(order.size());
+        for (int k = 0; k < order.size(); ++k) {
+            inverse[order[k]] = k;
         }
+        Layout rasterFrom = *currentLayout, rasterTo = *nextLayout;
+        applyOrder(rasterFrom.points, inverse);
+        applyOrder(rasterTo.points, inverse);
+
+        auto run = [&](const char* name, const Layout& from, const Layout& to) {
+            using clock = std::chrono::steady_clock;
+            int n = from.size();
+            std::vector<Vec3f> positions(n);
+
+            auto start = clock::now();
+            for (int i = 0; i < n; ++i) {
+                positions[i] = lerp(from.position(i), to.position(i), 0.5f);
+            }
+            auto lerped = clock::now();
+
+            // boxes around runs of 1024 consecutive points, then only the
+            // runs that touch the middle eighth of the cloud are visited
+            Vec3f centre = (to.min + to.max) / 2, half = (to.max - to.min) / 4;
+            Vec3f queryMin = centre - half, queryMax = centre + half;
+            int visited = 0, inside = 0;
+            for (int begin = 0; begin < n; begin += 1024) {
+                int end = std::min(begin + 1024, n);
+                Vec3f lo = positions[begin], hi = positions[begin];
+                for (int i = begin; i < end; ++i) {
+                    lo = min(lo, positions[i]);
+                    hi = max(hi, positions[i]);
+                }
+                bool overlaps = true;
+                for (int k = 0; k < 3; ++k) {
+                    overlaps = overlaps && lo[k] <= queryMax[k] && hi[k] >= queryMin[k];
+                }
+                if (!overlaps) continue;
+                for (int i = begin; i < end; ++i) {
+                    Vec3f p = positions[i];
+                    inside += p[0] >= queryMin[0] && p[0] <= queryMax[0] && p[1] >= queryMin[1] &&
+                              p[1] <= queryMax[1] && p[2] >= queryMin[2] && p[2] <= queryMax[2];
+                }
+                visited += end - begin;
+            }
+            auto culled = clock::now();
 
-        loadLayouts(img);
-        nav().pos(0, 0, 5);
+            auto ms = [](clock::duration d) { return std::chrono::duration<double, std::milli>(d).count(); };
+            std::cout << name << ": transition " << ms(lerped - start) << " ms, cull "
+                      << ms(culled - lerped) << " ms, visited " << visited << " points for "
+                      << inside << " hits" << std::endl;
+        };
 
-        if (!shader.compile(slurp("../point-vertex.glsl"),
-                            slurp("../point-fragment.glsl"),
-                            slurp("../point-geometry.glsl"))) {
+        run("raster", rasterFrom, rasterTo);
+        run(curve == Curve::Hilbert ? "hilbert" : "morton", *currentLayout, *nextLayout);
+    }
+
+    void onCreate() override {
+        if (!setupScene()) exit(1);
+
+        if (!compileShader()) {
             std::cerr << "Shader failed to compile.\n";
             exit(1);
         }
     }
 
+    // the layouts and the camera: everything but the shader, so a replay
+    // can run it without a window
+    bool setupScene() {
+        auto img = assets.image("../rainbow.jpg");
+        if (img->width() == 0) {
+            std::cerr << "Image failed to load.\n";
+            return false;
+        }
+
+        loadLayouts(*img);
+        nav().pos(0, 0, 5);
+        return true;
+    }
+
+    // as if just started, with rnd seeded; the frame budget stops adapting
+    // so that lodDistance only changes when the scenario says so
+    void restart(uint32_t seed) {
+        rnd::global().seed(seed);
+        frameBudget.adaptive.set(false);
+        culling = true;
+        show(layouts["image"]);
+    }
+
+    bool replay(const std::string& path) {
+        Scenario s;
+        if (!s.load(path)) return false;
+        s.setting(lodDistance, true);
+        if (!setupScene()) return false;
+        restart(s.seed);
+        ScenarioReport report = replayScenario(*this, s, [&]() { return stateChecksum(); });
+        report.print(std::cout, s.step);
+        report.writeTiming(path + ".timing.csv");
+        return true;
+    }
+
+    // what a replay prints, and capturing prints when it ends: the points
+    // as the shader places and colours them. the camera is not part of a
+    // scenario, so what culling picked is left out
+    uint64_t stateChecksum() {
+        std::vector<Vec3f> positions(currentLayout->size());
+        lerpLayouts(*currentLayout, *nextLayout, transitioning ? t : 0.0f, positions);
+        std::vector<Color> colors(currentLayout->size());
+        for (int i = 0; i < colors.size(); ++i) colors[i] = currentLayout->color(i);
+        return checksum(colors, checksum(positions));
+    }
+
     void onAnimate(double dt) override {
-        if (!transitioning) return;
+        frameBudget.start();
+        reloadChangedAssets();
+        dt = capture.advance(dt);  // the scenario's fixed step while capturing
+
+        // over budget: thin out points sooner; room to spare: keep detail further out
+        int step = frameBudget.decide();
+        if (step != 0) {
+            float scaled = lodDistance * (step > 0 ? 1.25f : 0.8f);
+            lodDistance.set(std::min(std::max(scaled, lodDistance.min()), lodDistance.max()));
+        }
+
+        if (transitioning) stepTransition(dt);
+        if (!culling) return;
+
+        // a replay has no window to take the aspect from
+        float aspect = height() > 0 ? float(width()) / height() : 1.0f;
+        ViewCamera cam = viewCamera(nav(), lens().fovy(), aspect, lens().near(), lens().far());
+        cullChunks(chunks, cam, lodDistance, visible);
+
+        // the points on the GPU stay where they are while the same chunks
+        // are in view, however far the transition is
+        if (regather || visible != drawnChunks) {
+            gatherVisible(currentLayout->points, chunks, visible, shownPoints);
+            resendShown = true;
+            if (transitioning) {
+                gatherVisible(nextLayout->points, chunks, visible, targetPoints);
+                resendTarget = true;
+            }
+            drawnChunks = visible;
+            regather = false;
+        }
+    }
 
+    // moves t along; the points themselves are only ever moved by the shader
+    void stepTransition(double dt) {
         elapsed += dt;
-        float t = elapsed / transitionTime;
-        if (t >= 1.0f) {
-            t = 1.0f;
-            transitioning = false;
-            currentLayout = nextLayout;
+        t = elapsed / transitionTime;
+        if (t < 1.0f) {
+            lerpChunkBounds(chunksOf[currentLayout], chunksOf[nextLayout], t, chunks);
+            return;
         }
 
-        for (int i = 0; i < interpolated.size(); ++i) {
-            interpolated[i] = lerp(currentLayout.positions[i], nextLayout.positions[i], t);
-            displayMesh.vertices()[i] = interpolated[i];
+        // over: the target is what is drawn now, and is on the GPU already
+        currentLayout = nextLayout;
+        chunks = chunksOf[currentLayout];
+        transitioning = false;
+        t = 0.0;
+        if (resendTarget) {
+            // never drawn: send the points that are drawn now instead
+            resendShown = true;
+            regather = true;
+        } else {
+            gpu.swap();
+            std::swap(shownPoints, targetPoints);
         }
+        resendTarget = false;
     }
 
     void onDraw(Graphics& g) override {
         g.clear(0.1);
         g.shader(shader);
         g.shader().uniform("pointSize", pointSize);
+        g.shader().uniform("vertexSize", 0.1f);
         g.blending(true);
         g.blendTrans();
         g.depthTesting(true);
-        g.draw(displayMesh);
+        if (resendShown) {
+            gpu.upload(*currentLayout, culling ? shownPoints : currentLayout->points);
+            resendShown = false;
+        }
+        if (resendTarget) {
+            gpu.uploadTarget(*nextLayout, culling ? targetPoints : nextLayout->points);
+            resendTarget = false;
+        }
+        gpu.draw(g, transitioning ? t : 0.0f);
+
+        frameBudget.stop();
     }
 
     bool onKeyDown(const Keyboard& k) override {
+        if (k.key() == 'r') {
+            if (capture.recording()) {
+                if (capture.end("revised.scenario"))
+                    std::cout << "checksum " << std::hex << stateChecksum() << std::dec << std::endl;
+            } else {
+                uint32_t seed = std::random_device()();
+                restart(seed);
+                capture.begin(seed);
+                capture.scenario.setting(lodDistance, false);
+            }
+            return true;
+        }
+        capture.key(k.key());
+
         if (k.key() == 'q') {  
           std::cout << "Exiting..." << std::endl; 
           quit(); 
@@ -178,28 +398,43 @@ class MyApp : public App {
         if (k.key() == '4') {
           startTransition("mine");
         }
+        if (k.key() == '5') {
+          startTransition("lab");
+        }
+
+        if (k.key() == 'c') {
+          culling = !culling;
+          regather = culling;
+          resendShown = true;
+          resendTarget = transitioning;
+        }
+        if (k.key() == 'b') {
+          benchmarkOrder();
+        }
 
         if (k.key() == ' ') {
-            displayMesh.reset();
-            interpolated.clear();
-            currentLayout.positions.clear();
-            currentLayout.colors.clear();
+            std::vector<Vec3f> positions;
+            std::vector<Color> colors;
             for (int i = 0; i < 100; ++i) {
-                Vec3f pos = randVec3();
-                Color c = randColor();
-                displayMesh.vertex(pos);
-                displayMesh.color(c);
-                displayMesh.texCoord(0.1, 0);
-                interpolated.push_back(pos);
-                currentLayout.positions.push_back(pos);
-                currentLayout.colors.push_back(c);
+                positions.push_back(randVec3());
+                colors.push_back(randColor());
             }
+            spaceLayout.pack(positions, colors);
+            chunksOf[&spaceLayout] = makeChunks(spaceLayout.positions());
+            show(spaceLayout);
         }
         return true;
     }
 };
 
-int main() {
-    MyApp().start();
+// ./revisedmain           draw, switch layouts with the keys
+// ./revisedmain replay revised.scenario
+//                         run a captured scenario headless, print the frame
+//                         times and the final state's checksum
+int main(int argc, char* argv[]) {
+    MyApp app;
+    if (argc > 1) app.mode = argv[1];
+    if (app.mode == "replay") return app.replay(argc > 2 ? argv[2] : "revised.scenario") ? 0 : 1;
+    app.start();
 }
 
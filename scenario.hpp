@@ -0,0 +1,207 @@
+#pragma once
+
+// scripted input, for runs that can be repeated exactly
+//
+//   capture:  capture.begin(seed);            // after reseeding rnd and restarting
+//             dt = capture.advance(dt);       // every onAnimate, before stepping
+//             capture.key(k.key());           // every onKeyDown
+//             capture.end("run.scenario");
+//
+//   replay:   Scenario s;  s.load("run.scenario");
+//             ... reseed with s.seed, restart ...
+//             ScenarioReport r = replayScenario(app, s, [&]() { return checksum(...); });
+//
+// a scenario is the rnd seed, the GUI settings it started from, the frame
+// step and count, and each key press with the frame it came before. while
+// capturing, advance() hands back the fixed step instead of the frame's
+// real dt, so the captured run steps exactly as a replay will. replay runs
+// the app without a window: it calls onAnimate with the fixed step and
+// onKeyDown before the frame each key came before, as fast as it can,
+// timing every frame. two replays of the same scenario end with the same
+// checksum, the same as the captured run's; a changed checksum means the
+// simulation changed.
+//
+// file (text):
+//   seed 1234
+//   step 0.0166667
+//   frames 600
+//   set /timeStep 0.1
+//   key 75 49            frame, key code
+
+#include "al/app/al_App.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace al;
+
+struct Scenario {
+    struct Event {
+        int frame;  // onKeyDown came before this frame's onAnimate
+        int key;
+    };
+
+    uint32_t seed = 1;
+    double step = 1 / 60.0;
+    int frames = 0;
+    std::vector<std::pair<std::string, float>> settings;
+    std::vector<Event> events;  // in frame order
+
+    // capturing: remember p's value. replaying: give p the remembered one
+    template <class P>
+    void setting(P& p, bool apply) {
+        std::string name = p.getName();
+        for (auto& s : settings) {
+            if (s.first != name) continue;
+            if (apply) p.set(decltype(p.get())(s.second));
+            else s.second = p.get();
+            return;
+        }
+        if (!apply) settings.emplace_back(name, float(p.get()));
+    }
+
+    bool save(const std::string& path) const {
+        std::ofstream out(path);
+        out.precision(9);
+        out << "seed " << seed << "\nstep " << step << "\nframes " << frames << "\n";
+        for (auto& s : settings) out << "set " << s.first << " " << s.second << "\n";
+        for (auto& e : events) out << "key " << e.frame << " " << e.key << "\n";
+        return bool(out);
+    }
+
+    bool load(const std::string& path) {
+        std::ifstream in(path);
+        if (!in) {
+            std::cerr << "scenario: cannot read " << path << std::endl;
+            return false;
+        }
+        *this = Scenario();
+        std::string line;
+        while (std::getline(in, line)) {
+            std::istringstream words(line);
+            std::string what;
+            if (!(words >> what)) continue;
+            if (what == "seed") words >> seed;
+            else if (what == "step") words >> step;
+            else if (what == "frames") words >> frames;
+            else if (what == "set") {
+                std::pair<std::string, float> s;
+                words >> s.first >> s.second;
+                settings.push_back(s);
+            } else if (what == "key") {
+                Event e;
+                words >> e.frame >> e.key;
+                events.push_back(e);
+            } else {
+                std::cerr << "scenario: " << path << ": what is '" << what << "'?" << std::endl;
+                return false;
+            }
+        }
+        std::stable_sort(events.begin(), events.end(),
+                         [](const Event& a, const Event& b) { return a.frame < b.frame; });
+        return true;
+    }
+};
+
+class ScenarioRecorder {
+public:
+    Scenario scenario;
+
+    bool recording() const { return on; }
+
+    void begin(uint32_t seed, double step = 1 / 60.0) {
+        scenario = Scenario();
+        scenario.seed = seed;
+        scenario.step = step;
+        on = true;
+    }
+
+    // the dt to step this frame with: the scenario's while capturing
+    double advance(double dt) {
+        if (!on) return dt;
+        ++scenario.frames;
+        return scenario.step;
+    }
+
+    void key(int key) {
+        if (on) scenario.events.push_back({scenario.frames, key});
+    }
+
+    bool end(const std::string& path) {
+        on = false;
+        if (!scenario.save(path)) return false;
+        std::cout << "wrote " << path << " (" << scenario.frames << " frames, " << scenario.events.size()
+                  << " keys)" << std::endl;
+        return true;
+    }
+
+private:
+    bool on = false;
+};
+
+// FNV-1a over the bytes of some arrays; chain calls to hash several
+template <class T>
+uint64_t checksum(const std::vector<T>& values, uint64_t hash = 14695981039346656037ull) {
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(values.data());
+    for (size_t k = 0; k < values.size() * sizeof(T); ++k) {
+        hash ^= bytes[k];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+struct ScenarioReport {
+    std::vector<double> frameMs;  // onKeyDown + onAnimate, per frame
+    double seconds = 0;           // the whole replay
+    uint64_t checksum = 0;
+
+    void print(std::ostream& out, double step) const {
+        std::vector<double> sorted = frameMs;
+        std::sort(sorted.begin(), sorted.end());
+        auto at = [&](double q) { return sorted.empty() ? 0 : sorted[size_t(q * (sorted.size() - 1))]; };
+        double simulated = frameMs.size() * step;
+        out << "replayed " << frameMs.size() << " frames in " << seconds << " s ("
+            << (seconds > 0 ? simulated / seconds : 0) << "x real time)\n"
+            << "frame ms: median " << at(0.5) << ", p99 " << at(0.99) << ", max " << at(1) << "\n"
+            << "checksum " << std::hex << checksum << std::dec << std::endl;
+    }
+
+    void writeTiming(const std::string& path) const {
+        std::ofstream out(path);
+        out << "frame,ms\n";
+        for (int f = 0; f < frameMs.size(); ++f) out << f << "," << frameMs[f] << "\n";
+    }
+};
+
+// drives an app that has been restarted from s.seed and s.settings;
+// onCreate and everything that needs a window are the caller's business
+template <class A>
+ScenarioReport replayScenario(A& app, const Scenario& s, std::function<uint64_t()> state) {
+    using clock = std::chrono::steady_clock;
+    ScenarioReport report;
+    report.frameMs.reserve(s.frames);
+    size_t next = 0;
+    auto begin = clock::now();
+    for (int f = 0; f < s.frames; ++f) {
+        auto start = clock::now();
+        // keys that came before this frame
+        while (next < s.events.size() && s.events[next].frame <= f) {
+            Keyboard k;
+            k.setKey(s.events[next++].key, true);
+            app.onKeyDown(k);
+        }
+        app.onAnimate(s.step);
+        report.frameMs.push_back(std::chrono::duration<double, std::milli>(clock::now() - start).count());
+    }
+    report.seconds = std::chrono::duration<double>(clock::now() - begin).count();
+    report.checksum = state();
+    return report;
+}
@@ -0,0 +1,424 @@
+#pragma once
+
+// one process simulates, any number of local processes render
+//
+//   simulator:  StateServer server;  server.open(9010, Vec3f(-20), Vec3f(20));
+//               server.send(state);                // once per frame
+//   renderer:   StateClient client;  client.open("127.0.0.1", 9010);
+//               if (client.receive(state)) ...     // newest frame, never blocks
+//
+// state goes over UDP. positions are quantised to 16 bits inside a box
+// fitted around them (within the bounds given to open(), see
+// trajectory::fitBounds), colours to 8 bits, quaternion components to 16
+// bits. the box is kept while the positions stay in it and refitted when
+// they leave it or gather into a quarter of it. each client acks
+// the frames it decodes, and the server sends it zigzag/varint deltas
+// (zeros run-length coded) against the last frame that client acked (the whole frame if that one
+// is too old, or the object count or the box changed). a lost packet only means the
+// next delta is against an older frame. frames bigger than one datagram
+// are split into chunks. the server prints each client's bandwidth every
+// few seconds. POSIX sockets only.
+
+#include "al/graphics/al_Color.hpp"
+#include "al/math/al_Quat.hpp"
+#include "al/math/al_Vec.hpp"
+#include "trajectory.hpp"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+using namespace al;
+
+struct WorldState {
+    std::vector<Vec3f> positions;
+    std::vector<Color> colors;
+    std::vector<Quatf> orientations;
+};
+
+namespace statelink {
+
+const uint32_t frameMagic = 0x54415453;  // "STAT"
+const uint32_t ackMagic = 0x5f4b4341;    // "ACK_"
+const uint32_t none = 0xffffffff;
+const int history = 64;        // frames either side keeps for deltas
+const int chunkBytes = 60000;  // payload per datagram
+const uint32_t maxValues = 1 << 24;  // a frame claiming more is garbage
+
+struct FramePacket {
+    uint32_t magic;
+    uint32_t frame;
+    uint32_t base;  // frame the deltas are against, or none for a whole frame
+    uint16_t chunk, chunks;
+    uint32_t positions, colors, orientations;
+    uint32_t bytes;  // payload size of the whole frame
+    float min[3], max[3];
+};
+
+struct AckPacket {
+    uint32_t magic;
+    uint32_t frame;  // none: just saying hello
+};
+
+inline void quantise(const WorldState& s, const trajectory::Bounds& box, std::vector<uint16_t>& out) {
+    out.clear();
+    auto clamp16 = [](float q) { return uint16_t(std::min(std::max(q, 0.0f), 65535.0f) + 0.5f); };
+    for (auto& p : s.positions) {
+        for (int k = 0; k < 3; ++k) out.push_back(trajectory::quantise(p[k], box, k));
+    }
+    for (auto& c : s.colors) {
+        for (float v : {c.r, c.g, c.b, c.a}) out.push_back(clamp16(v * 255.0f) & 0xff);
+    }
+    for (auto& o : s.orientations) {
+        for (float v : {o.w, o.x, o.y, o.z}) out.push_back(clamp16((v + 1.0f) * 32767.5f));
+    }
+}
+
+inline void dequantise(const std::vector<uint16_t>& in, const FramePacket& h, WorldState& s) {
+    s.positions.resize(h.positions);
+    s.colors.resize(h.colors);
+    s.orientations.resize(h.orientations);
+    const uint16_t* v = in.data();
+    for (auto& p : s.positions) {
+        for (int k = 0; k < 3; ++k) p[k] = h.min[k] + *v++ * (h.max[k] - h.min[k]) / 65535.0f;
+    }
+    for (auto& c : s.colors) {
+        c = Color(v[0] / 255.0f, v[1] / 255.0f, v[2] / 255.0f, v[3] / 255.0f);
+        v += 4;
+    }
+    for (auto& o : s.orientations) {
+        auto q = [](uint16_t x) { return x / 32767.5f - 1.0f; };
+        o = Quatf(q(v[0]), q(v[1]), q(v[2]), q(v[3])).normalize();
+        v += 4;
+    }
+}
+
+inline void encode(const std::vector<uint16_t>& values, const std::vector<uint16_t>* base,
+                   std::vector<uint8_t>& out) {
+    out.clear();
+    if (!base) {
+        auto bytes = reinterpret_cast<const uint8_t*>(values.data());
+        out.assign(bytes, bytes + values.size() * sizeof(uint16_t));
+        return;
+    }
+    // a zero delta is followed by how many more zeros come after it, so
+    // whatever did not move (colours, mostly) costs next to nothing
+    for (size_t i = 0; i < values.size();) {
+        uint32_t d = trajectory::zigzag(int32_t(values[i]) - int32_t((*base)[i]));
+        trajectory::putVarint(out, d);
+        ++i;
+        if (d != 0) continue;
+        size_t run = i;
+        while (run < values.size() && values[run] == (*base)[run]) ++run;
+        trajectory::putVarint(out, run - i);
+        i = run;
+    }
+}
+
+// false if in is not exactly count values encoded against base (which
+// must hold count values too); values is then garbage
+inline bool decode(const std::vector<uint8_t>& in, size_t count, const std::vector<uint16_t>* base,
+                   std::vector<uint16_t>& values) {
+    if (count > maxValues) return false;
+    values.resize(count);
+    if (!base) {
+        if (in.size() != count * sizeof(uint16_t)) return false;
+        if (count > 0) std::memcpy(values.data(), in.data(), count * sizeof(uint16_t));
+        return true;
+    }
+    if (base->size() != count) return false;
+    const uint8_t *p = in.data(), *end = p + in.size();
+    for (size_t i = 0; i < count;) {
+        uint32_t d, run;
+        if (!trajectory::getVarint(p, end, d)) return false;
+        values[i] = uint16_t(int32_t((*base)[i]) + trajectory::unzigzag(d));
+        ++i;
+        if (d != 0) continue;
+        if (!trajectory::getVarint(p, end, run) || run > count - i) return false;
+        for (; run > 0; --run, ++i) values[i] = (*base)[i];
+    }
+    return p == end;
+}
+
+// values in a frame with this header
+inline size_t valueCount(const FramePacket& h) {
+    return size_t(h.positions) * 3 + (size_t(h.colors) + h.orientations) * 4;
+}
+
+// what the header says agrees with itself and with a datagram of length
+// bytes: the chunk is one of the frame's, and fits inside the payload
+inline bool plausible(const FramePacket& h, size_t length) {
+    if (h.magic != frameMagic) return false;
+    if (h.positions > maxValues || h.colors > maxValues || h.orientations > maxValues) return false;
+    if (valueCount(h) > maxValues || h.bytes > maxValues * 5ull) return false;
+    uint32_t chunks = std::max<uint32_t>((h.bytes + chunkBytes - 1) / chunkBytes, 1);
+    if (h.chunks != chunks || h.chunk >= chunks) return false;
+    size_t begin = size_t(h.chunk) * chunkBytes;
+    size_t end = std::min<size_t>(h.bytes, begin + chunkBytes);
+    return length == sizeof(FramePacket) + (end - begin);
+}
+
+inline double now() {
+    using namespace std::chrono;
+    return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+}  // namespace statelink
+
+class StateServer {
+public:
+    double reportEvery = 2.0;  // seconds between bandwidth reports, 0 for none
+
+    ~StateServer() {
+        if (sock >= 0) close(sock);
+    }
+
+    bool open(int port, Vec3f min, Vec3f max) {
+        for (int k = 0; k < 3; ++k) {
+            outer.min[k] = min[k];
+            outer.max[k] = max[k];
+        }
+        box = outer;
+        sock = socket(AF_INET, SOCK_DGRAM, 0);
+        if (sock < 0) return false;
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = htons(port);
+        if (bind(sock, (sockaddr*)&addr, sizeof(addr)) != 0) {
+            std::cerr << "state server: port " << port << " is busy" << std::endl;
+            close(sock);
+            sock = -1;
+            return false;
+        }
+        lastReport = statelink::now();
+        return true;
+    }
+
+    void send(const WorldState& state) {
+        if (sock < 0) return;
+        readAcks();
+
+        // a new box makes every client's next frame a whole one, so only
+        // when the positions left the old one or it got much too big
+        trajectory::Bounds fitted = trajectory::fitBounds(state.positions, outer);
+        bool gathered = false;
+        for (int k = 0; k < 3; ++k) {
+            gathered = gathered || (fitted.max[k] - fitted.min[k]) * 4 < box.max[k] - box.min[k];
+        }
+        if (gathered || !trajectory::inside(state.positions, outer, box)) box = fitted;
+
+        std::vector<uint16_t> values;
+        statelink::quantise(state, box, values);
+        uint32_t number = frame++;
+
+        statelink::FramePacket h{};
+        h.magic = statelink::frameMagic;
+        h.frame = number;
+        h.positions = state.positions.size();
+        h.colors = state.colors.size();
+        h.orientations = state.orientations.size();
+        for (int k = 0; k < 3; ++k) {
+            h.min[k] = box.min[k];
+            h.max[k] = box.max[k];
+        }
+
+        // clients that acked the same frame get the same payload
+        std::map<uint32_t, std::vector<uint8_t>> payloads;
+        for (auto& c : clients) {
+            const std::vector<uint16_t>* base = nullptr;
+            for (auto& old : sent) {
+                if (old.frame == c.acked && old.values.size() == values.size() && old.box == box) base = &old.values;
+            }
+            uint32_t baseFrame = base ? c.acked : statelink::none;
+            auto& payload = payloads[baseFrame];
+            if (payload.empty()) statelink::encode(values, base, payload);
+
+            h.base = baseFrame;
+            h.bytes = payload.size();
+            h.chunks = std::max<size_t>((payload.size() + statelink::chunkBytes - 1) / statelink::chunkBytes, 1);
+            std::vector<uint8_t> packet;
+            for (h.chunk = 0; h.chunk < h.chunks; ++h.chunk) {
+                size_t begin = size_t(h.chunk) * statelink::chunkBytes;
+                size_t end = std::min(payload.size(), begin + statelink::chunkBytes);
+                packet.resize(sizeof(h) + end - begin);
+                std::memcpy(packet.data(), &h, sizeof(h));
+                std::copy(payload.begin() + begin, payload.begin() + end, packet.begin() + sizeof(h));
+                sendto(sock, packet.data(), packet.size(), 0, (sockaddr*)&c.addr, sizeof(c.addr));
+                c.bytes += packet.size();
+            }
+        }
+
+        sent.push_back({number, std::move(values), box});
+        if (sent.size() > statelink::history) sent.pop_front();
+        report();
+    }
+
+private:
+    struct Client {
+        sockaddr_in addr;
+        uint32_t acked = statelink::none;
+        double heard = 0;
+        uint64_t bytes = 0;
+    };
+
+    // a frame as quantised, for the deltas against it
+    struct Sent {
+        uint32_t frame;
+        std::vector<uint16_t> values;
+        trajectory::Bounds box;
+    };
+
+    int sock = -1;
+    trajectory::Bounds outer, box;  // open()'s bounds, the current one
+    uint32_t frame = 0;
+    std::vector<Client> clients;
+    std::deque<Sent> sent;
+    double lastReport = 0;
+
+    void readAcks() {
+        statelink::AckPacket ack;
+        sockaddr_in from{};
+        socklen_t length = sizeof(from);
+        while (recvfrom(sock, &ack, sizeof(ack), MSG_DONTWAIT, (sockaddr*)&from, &length) == sizeof(ack)) {
+            if (ack.magic != statelink::ackMagic) continue;
+            auto c = std::find_if(clients.begin(), clients.end(), [&](const Client& c) {
+                return c.addr.sin_port == from.sin_port && c.addr.sin_addr.s_addr == from.sin_addr.s_addr;
+            });
+            if (c == clients.end()) {
+                std::cout << "state server: renderer on port " << ntohs(from.sin_port) << " joined" << std::endl;
+                clients.push_back(Client{from});
+                c = clients.end() - 1;
+            }
+            if (ack.frame != statelink::none && (c->acked == statelink::none || ack.frame > c->acked)) {
+                c->acked = ack.frame;
+            }
+            c->heard = statelink::now();
+            length = sizeof(from);
+        }
+
+        // renderers that stopped acking have gone away
+        double cutoff = statelink::now() - 3.0;
+        clients.erase(std::remove_if(clients.begin(), clients.end(),
+                                     [cutoff](const Client& c) { return c.heard < cutoff; }),
+                      clients.end());
+    }
+
+    void report() {
+        double t = statelink::now();
+        if (reportEvery <= 0 || t - lastReport < reportEvery) return;
+        for (auto& c : clients) {
+            std::cout << "state server: renderer on port " << ntohs(c.addr.sin_port) << " "
+                      << c.bytes / (t - lastReport) / 1024 << " KiB/s" << std::endl;
+            c.bytes = 0;
+        }
+        lastReport = t;
+    }
+};
+
+class StateClient {
+public:
+    ~StateClient() {
+        if (sock >= 0) close(sock);
+    }
+
+    bool open(const std::string& host, int port) {
+        sock = socket(AF_INET, SOCK_DGRAM, 0);
+        if (sock < 0) return false;
+        // room for a few whole frames between two receive() calls
+        int buffer = 4 << 20;
+        setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &buffer, sizeof(buffer));
+        server = sockaddr_in{};
+        server.sin_family = AF_INET;
+        server.sin_port = htons(port);
+        inet_pton(AF_INET, host.c_str(), &server.sin_addr);
+        sendAck(statelink::none);
+        return true;
+    }
+
+    // the newest frame that arrived whole since the last call
+    bool receive(WorldState& state) {
+        if (sock < 0) return false;
+
+        bool got = false;
+        std::vector<uint8_t> packet(sizeof(statelink::FramePacket) + statelink::chunkBytes);
+        ssize_t length;
+        while ((length = recv(sock, packet.data(), packet.size(), MSG_DONTWAIT)) >= ssize_t(sizeof(statelink::FramePacket))) {
+            statelink::FramePacket h;
+            std::memcpy(&h, packet.data(), sizeof(h));
+            if (!statelink::plausible(h, length)) continue;
+
+            // far behind is a restarted server, not a late packet
+            if (lastFrame != statelink::none && h.frame + statelink::history < lastFrame) lastFrame = statelink::none;
+            if (lastFrame != statelink::none && h.frame <= lastFrame) continue;  // late, or one we have
+            if (h.frame != assembling.frame || h.base != assembling.base) {
+                if (h.frame < assembling.frame && assembling.frame != statelink::none) continue;  // late
+                assembling = h;
+                payload.assign(h.bytes, 0);
+                arrived.assign(h.chunks, false);
+            } else if (!sameFrame(h, assembling)) {
+                continue;  // same number, different frame: not ours to trust
+            }
+            if (arrived[h.chunk]) continue;  // duplicate
+            arrived[h.chunk] = true;
+            size_t begin = size_t(h.chunk) * statelink::chunkBytes;
+            std::copy(packet.begin() + sizeof(h), packet.begin() + length, payload.begin() + begin);
+            if (std::find(arrived.begin(), arrived.end(), false) != arrived.end()) continue;
+            assembling.frame = statelink::none;
+            assembling.base = statelink::none;
+            lastFrame = h.frame;
+
+            // whole frame: decode against the frame the server based it on
+            const std::vector<uint16_t>* base = nullptr;
+            if (h.base != statelink::none) {
+                for (auto& old : decoded) {
+                    if (old.first == h.base) base = &old.second;
+                }
+                if (!base) continue;  // we never kept that one; wait for the next frame
+            }
+            std::vector<uint16_t> values;
+            if (!statelink::decode(payload, statelink::valueCount(h), base, values)) continue;
+            statelink::dequantise(values, h, state);
+            decoded.push_back({h.frame, std::move(values)});
+            if (decoded.size() > statelink::history) decoded.pop_front();
+            sendAck(h.frame);
+            got = true;
+        }
+
+        // keep saying hello until the server notices us
+        if (!got && statelink::now() - lastAck > 1.0) sendAck(statelink::none);
+        return got;
+    }
+
+private:
+    int sock = -1;
+    sockaddr_in server{};
+    statelink::FramePacket assembling{0, statelink::none, statelink::none};
+    std::vector<uint8_t> payload;
+    std::vector<bool> arrived;  // per chunk of the frame being assembled
+    uint32_t lastFrame = statelink::none;  // newest frame completed
+    std::deque<std::pair<uint32_t, std::vector<uint16_t>>> decoded;
+    double lastAck = 0;
+
+    static bool sameFrame(const statelink::FramePacket& a, const statelink::FramePacket& b) {
+        return a.bytes == b.bytes && a.chunks == b.chunks && a.positions == b.positions &&
+               a.colors == b.colors && a.orientations == b.orientations;
+    }
+
+    void sendAck(uint32_t frame) {
+        statelink::AckPacket ack{statelink::ackMagic, frame};
+        sendto(sock, &ack, sizeof(ack), 0, (sockaddr*)&server, sizeof(server));
+        lastAck = statelink::now();
+    }
+};
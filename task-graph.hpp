@@ -0,0 +1,256 @@
+#pragma once
+
+// a frame's work as tasks that say what they read and write, run on a
+// small work-stealing thread pool
+//
+//   TaskGraph graph;
+//   graph.add("springs", {&position, &springs}, {&springForce}, [&] { ... });
+//   graph.add("integrate", {&springForce}, {&position}, [&] { ... });
+//   TaskScheduler scheduler;
+//   scheduler.run(graph);     // every frame; the calling thread helps
+//
+// resources are just addresses. a task waits for every earlier task that
+// writes something it reads or writes, or reads something it writes;
+// everything else may run at the same time. each worker keeps its own
+// queue of ready tasks, takes the newest from its own and steals the
+// oldest from the others when it runs dry; with nothing to steal it
+// sleeps until a task becomes ready or the graph is done. with tracing
+// on, run() records which worker ran which task when; writeTrace() saves
+// that for chrome://tracing or ui.perfetto.dev.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class TaskGraph {
+public:
+    using Resource = const void*;
+
+    struct Task {
+        std::string name;
+        std::vector<Resource> reads, writes;
+        std::function<void()> run;
+        std::vector<int> next;  // tasks waiting on this one
+        int waits = 0;          // tasks this one waits on
+    };
+
+    int add(const std::string& name, std::vector<Resource> reads, std::vector<Resource> writes,
+            std::function<void()> run) {
+        Task task{name, std::move(reads), std::move(writes), std::move(run)};
+        int id = tasks.size();
+        for (int e = 0; e < id; ++e) {
+            Task& earlier = tasks[e];
+            if (overlap(earlier.writes, task.reads) || overlap(earlier.writes, task.writes) ||
+                overlap(earlier.reads, task.writes)) {
+                earlier.next.push_back(id);
+                ++task.waits;
+            }
+        }
+        tasks.push_back(std::move(task));
+        return id;
+    }
+
+    void clear() { tasks.clear(); }
+
+    std::vector<Task> tasks;
+
+private:
+    static bool overlap(const std::vector<Resource>& a, const std::vector<Resource>& b) {
+        for (auto r : a) {
+            if (std::find(b.begin(), b.end(), r) != b.end()) return true;
+        }
+        return false;
+    }
+};
+
+class TaskScheduler {
+public:
+    struct Placement {
+        int task, worker;
+        double start, end;  // microseconds since run() began
+    };
+
+    bool tracing = false;
+    std::vector<Placement> trace;  // of the last run() with tracing on
+
+    explicit TaskScheduler(int workers = std::thread::hardware_concurrency()) {
+        workers = std::max(workers, 1);
+        for (int w = 0; w < workers; ++w) queues.emplace_back(new Queue);
+        for (int w = 1; w < workers; ++w) threads.emplace_back([this, w]() { work(w); });
+    }
+
+    ~TaskScheduler() {
+        {
+            std::lock_guard<std::mutex> lock(wakeMutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto& t : threads) t.join();
+    }
+
+    int workers() const { return queues.size(); }
+
+    // returns when every task of the graph has run
+    void run(TaskGraph& g) {
+        if (g.tasks.empty()) return;
+        graph = &g;
+        trace.clear();
+        begin = clock::now();
+        // counted before anything is queued: a worker still leaving the
+        // last run may already pick these up
+        remaining = g.tasks.size();
+        waits.reset(new std::atomic<int>[g.tasks.size()]);
+        for (int t = 0; t < g.tasks.size(); ++t) waits[t] = g.tasks[t].waits;
+        for (int t = 0; t < g.tasks.size(); ++t) {
+            if (g.tasks[t].waits > 0) continue;
+            Queue& q = *queues[t % queues.size()];
+            {
+                std::lock_guard<std::mutex> lock(q.mutex);
+                q.tasks.push_back(t);
+            }
+            // a helper still parked in the last run's help() only wakes
+            // for posted tasks
+            ++posted;
+        }
+        signal(true);
+        {
+            std::lock_guard<std::mutex> lock(wakeMutex);
+            ++generation;
+        }
+        wake.notify_all();
+
+        help(0);
+    }
+
+    // chrome://tracing format: one row per worker
+    void writeTrace(const std::string& path) const {
+        std::ofstream out(path);
+        out << "[\n";
+        for (int k = 0; k < trace.size(); ++k) {
+            auto& p = trace[k];
+            out << "  {\"name\": \"" << graph->tasks[p.task].name << "\", \"ph\": \"X\", \"pid\": 0, \"tid\": "
+                << p.worker << ", \"ts\": " << p.start << ", \"dur\": " << p.end - p.start << "}"
+                << (k + 1 < trace.size() ? ",\n" : "\n");
+        }
+        out << "]\n";
+    }
+
+private:
+    using clock = std::chrono::steady_clock;
+
+    struct Queue {
+        std::mutex mutex;
+        std::deque<int> tasks;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> threads;
+    std::mutex wakeMutex, traceMutex;
+    std::condition_variable wake, ready;
+    bool stopping = false;
+    unsigned generation = 0;
+    std::atomic<unsigned> posted{0};  // tasks queued so far, for sleepers to notice
+    std::atomic<int> sleeping{0};     // helpers waiting on ready
+
+    TaskGraph* graph = nullptr;
+    std::unique_ptr<std::atomic<int>[]> waits;
+    std::atomic<int> remaining{0};
+    clock::time_point begin;
+
+    void work(int w) {
+        unsigned seen = 0;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(wakeMutex);
+                wake.wait(lock, [&]() { return stopping || generation != seen; });
+                if (stopping) return;
+                seen = generation;
+            }
+            help(w);
+        }
+    }
+
+    // runs tasks until the whole graph is done
+    void help(int w) {
+        while (remaining > 0) {
+            // read before looking, so a task queued after we looked wakes us
+            unsigned seen = posted;
+            int task;
+            if (take(w, task)) {
+                execute(w, task);
+                continue;
+            }
+            ++sleeping;
+            {
+                std::unique_lock<std::mutex> lock(wakeMutex);
+                ready.wait(lock, [&]() { return remaining == 0 || posted != seen; });
+            }
+            --sleeping;
+        }
+    }
+
+    // after queueing a task or finishing the graph. the lock orders this
+    // against a helper between checking and sleeping
+    void signal(bool all) {
+        if (sleeping == 0) return;
+        { std::lock_guard<std::mutex> lock(wakeMutex); }
+        if (all) ready.notify_all();
+        else ready.notify_one();
+    }
+
+    // newest from our own queue, else the oldest from someone else's
+    bool take(int w, int& task) {
+        {
+            Queue& own = *queues[w];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if (!own.tasks.empty()) {
+                task = own.tasks.back();
+                own.tasks.pop_back();
+                return true;
+            }
+        }
+        for (int k = 1; k < queues.size(); ++k) {
+            Queue& other = *queues[(w + k) % queues.size()];
+            std::lock_guard<std::mutex> lock(other.mutex);
+            if (!other.tasks.empty()) {
+                task = other.tasks.front();
+                other.tasks.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void execute(int w, int task) {
+        double start = tracing ? since() : 0;
+        graph->tasks[task].run();
+        if (tracing) {
+            double end = since();
+            std::lock_guard<std::mutex> lock(traceMutex);
+            trace.push_back({task, w, start, end});
+        }
+
+        for (int n : graph->tasks[task].next) {
+            if (--waits[n] == 0) {
+                {
+                    std::lock_guard<std::mutex> lock(queues[w]->mutex);
+                    queues[w]->tasks.push_back(n);
+                }
+                ++posted;
+                signal(false);
+            }
+        }
+        if (--remaining == 0) signal(true);
+    }
+
+    double since() const { return std::chrono::duration<double, std::micro>(clock::now() - begin).count(); }
+};
@@ -0,0 +1,44 @@
+#pragma once
+
+// what the programs in tests/ share
+//
+//   CHECK(x.size() == 3);          // prints the line and carries on if false
+//   CHECK_NEAR(a, b, 1e-6);
+//   return checkResult("edge set");  // 1 if any check failed
+//
+// build each test like any other sketch; they open no window.
+
+#include <cmath>
+#include <iostream>
+
+inline int& checkFailures() {
+    static int failures = 0;
+    return failures;
+}
+
+#define CHECK(condition)                                                                   \
+    do {                                                                                   \
+        if (!(condition)) {                                                                \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": failed: " #condition << std::endl; \
+            ++checkFailures();                                                             \
+        }                                                                                  \
+    } while (0)
+
+#define CHECK_NEAR(a, b, tolerance)                                                           \
+    do {                                                                                      \
+        double a_ = (a), b_ = (b);                                                            \
+        if (!(std::abs(a_ - b_) <= (tolerance))) {                                            \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": failed: " #a " == " #b " (" << a_ \
+                      << " vs " << b_ << ")" << std::endl;                                    \
+            ++checkFailures();                                                                \
+        }                                                                                     \
+    } while (0)
+
+inline int checkResult(const char* name) {
+    if (checkFailures() == 0) {
+        std::cout << name << ": ok" << std::endl;
+        return 0;
+    }
+    std::cout << name << ": " << checkFailures() << " failed" << std::endl;
+    return 1;
+}
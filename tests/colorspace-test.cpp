@@ -0,0 +1,136 @@
+// colorspace.hpp against the scalar allolib path. a sweep over hue,
+// saturation and value goes to RGB with al::RGB(al::HSV), and the batch
+// rgbToHsv must give back what al::HSV(al::RGB) gives, to within the
+// bounds below. sincosTurns is held to the 5e-7 its comment promises, and
+// hsvToCylindrical to the libm cylinder. link it against allolib itself:
+// al::HSV and al::RGB are the reference, and their conversions live in
+// al_Color.cpp, not in the header.
+
+#include "../colorspace.hpp"
+#include "al/graphics/al_Color.hpp"
+#include "check.hpp"
+
+using namespace colorspace;
+
+// hue is a circle: 0.999 and 0.001 are 0.002 apart
+double hueError(float a, float b) {
+    double d = std::abs(double(a) - b);
+    return std::min(d, 1 - d);
+}
+
+// every (h, s, v) on a grid, as al::RGB makes it, plus the corners and
+// greys where hue and saturation are degenerate
+RGBArrays sweep() {
+    RGBArrays rgb;
+    auto add = [&](const al::RGB& c) {
+        rgb.r.push_back(c.r);
+        rgb.g.push_back(c.g);
+        rgb.b.push_back(c.b);
+    };
+    for (int h = 0; h < 720; ++h) {
+        for (int s = 0; s <= 32; ++s) {
+            for (int v = 0; v <= 32; ++v) {
+                add(al::RGB(al::HSV(h / 720.0f, s / 32.0f, v / 32.0f)));
+            }
+        }
+    }
+    for (int k = 0; k <= 255; ++k) add(al::RGB(k / 255.0f));
+    return rgb;
+}
+
+void testRgbToHsv() {
+    RGBArrays rgb = sweep();
+    int n = rgb.size();
+    std::vector<float> h(n), s(n), v(n);
+    rgbToHsv(rgb.r.data(), rgb.g.data(), rgb.b.data(), n, h.data(), s.data(), v.data());
+
+    double hMax = 0, sMax = 0, vMax = 0;
+    for (int i = 0; i < n; ++i) {
+        al::HSV expected(al::RGB(rgb.r[i], rgb.g[i], rgb.b[i]));
+        // hue means nothing without saturation: both must say 0 there
+        if (expected.s > 0) hMax = std::max(hMax, hueError(h[i], expected.h));
+        else CHECK(h[i] == 0 && s[i] == 0);
+        sMax = std::max(sMax, std::abs(double(s[i]) - expected.s));
+        vMax = std::max(vMax, std::abs(double(v[i]) - expected.v));
+        CHECK(h[i] >= 0 && h[i] < 1);
+    }
+    std::cout << n << " colours: max error hue " << hMax << ", saturation " << sMax << ", value " << vMax
+              << std::endl;
+    CHECK(hMax < 1e-6);
+    CHECK(sMax < 1e-6);
+    CHECK(vMax < 1e-6);
+
+    // through 8-bit pixels: unpacked like an image, then converted
+    std::vector<uint8_t> pixels;
+    for (int r = 0; r < 256; r += 15) {
+        for (int g = 0; g < 256; g += 15) {
+            for (int b = 0; b < 256; b += 15) pixels.insert(pixels.end(), {uint8_t(r), uint8_t(g), uint8_t(b), 255});
+        }
+    }
+    int count = pixels.size() / 4;
+    RGBArrays unpacked;
+    unpackRGB8(pixels.data(), count, 4, unpacked);
+    h.resize(count);
+    s.resize(count);
+    v.resize(count);
+    rgbToHsv(unpacked.r.data(), unpacked.g.data(), unpacked.b.data(), count, h.data(), s.data(), v.data());
+    for (int i = 0; i < count; ++i) {
+        al::HSV expected(al::RGB(pixels[i * 4] / 255.0f, pixels[i * 4 + 1] / 255.0f, pixels[i * 4 + 2] / 255.0f));
+        if (expected.s > 0) CHECK(hueError(h[i], expected.h) < 1e-6);
+        CHECK_NEAR(s[i], expected.s, 1e-6);
+        CHECK_NEAR(v[i], expected.v, 1e-6);
+    }
+}
+
+// a red hue a hair below 0 wraps to 6 sixths when 6 is added in float; it
+// must come out as 0, inside [0, 1)
+void testHueWrap() {
+    float r = 1, g = 0.5f, b = std::nextafter(0.5f, 1.0f), h, s, v;
+    rgbToHsv(&r, &g, &b, 1, &h, &s, &v);
+    CHECK(h >= 0 && h < 1);
+    CHECK(hueError(h, 0) < 1e-6);
+    CHECK_NEAR(s, 0.5, 1e-6);
+}
+
+// the bound the comment on sincosTurns gives, over a whole turn and a few
+// turns either side of it
+void testSinCos() {
+    double worst = 0;
+    for (int i = -4000000; i <= 4000000; ++i) {
+        float turns = i / 1000000.0f;
+        float s, c;
+        sincosTurns(turns, s, c);
+        double a = 2 * M_PI * double(turns);
+        worst = std::max(worst, std::max(std::abs(s - std::sin(a)), std::abs(c - std::cos(a))));
+    }
+    std::cout << "sincosTurns: max error " << worst << std::endl;
+    CHECK(worst < 5e-7);
+}
+
+void testCylinder() {
+    int n = 360 * 17;
+    std::vector<float> h(n), s(n), v(n);
+    for (int i = 0; i < n; ++i) {
+        h[i] = (i % 360) / 360.0f;
+        s[i] = (i / 360) / 16.0f;
+        v[i] = 0.25f;
+    }
+    std::vector<Vec3f> out(n);
+    hsvToCylindrical(h.data(), s.data(), v.data(), n, out.data());
+    double worst = 0;
+    for (int i = 0; i < n; ++i) {
+        double a = 2 * M_PI * double(h[i]);
+        worst = std::max(worst, std::abs(out[i][0] - std::cos(a) * s[i]));
+        worst = std::max(worst, std::abs(out[i][2] - std::sin(a) * s[i]));
+        CHECK(out[i][1] == v[i]);
+    }
+    CHECK(worst < 5e-7);
+}
+
+int main() {
+    testRgbToHsv();
+    testHueWrap();
+    testSinCos();
+    testCylinder();
+    return checkResult("colorspace");
+}
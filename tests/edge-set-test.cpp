@@ -0,0 +1,152 @@
+// ass2/edge-set.hpp: a pair is linked once whichever way round, the slot
+// hash follows every link that removals move, remap() drops the links of
+// removed particles and merges the ones that become the same pair, and
+// compact() sorts by particle. after every change each link must be found
+// at its own slot.
+
+#include "../ass2/edge-set.hpp"
+#include "check.hpp"
+
+#include <random>
+#include <set>
+#include <utility>
+
+struct Link {
+    int i, j;
+    float value;
+};
+
+// every link is contained, removing it by pair finds the right slot, and
+// no pair is there twice
+void checkConsistent(const EdgeSet<Link>& links) {
+    std::set<std::pair<int, int>> pairs;
+    for (int k = 0; k < links.size(); ++k) {
+        const Link& l = links[k];
+        CHECK(l.i != l.j);
+        CHECK(links.contains(l.i, l.j) && links.contains(l.j, l.i));
+        CHECK(pairs.insert({std::min(l.i, l.j), std::max(l.i, l.j)}).second);
+    }
+    // removing every link through the hash must empty the array
+    EdgeSet<Link> copy = links;
+    for (auto& p : pairs) CHECK(copy.remove(p.second, p.first));
+    CHECK(copy.size() == 0);
+}
+
+void testAdd() {
+    EdgeSet<Link> links;
+    CHECK(links.add({1, 2, 0.5f}));
+    CHECK(!links.add({1, 2, 9}));  // the same pair
+    CHECK(!links.add({2, 1, 9}));  // reversed
+    CHECK(!links.add({3, 3, 9}));  // to itself
+    CHECK(links.add({2, 3, 1}));
+    CHECK(links.size() == 2 && links[0].value == 0.5f);
+
+    // a batch: duplicates within it and of what is there are skipped
+    std::vector<Link> batch = {{4, 5, 0}, {5, 4, 0}, {1, 2, 0}, {6, 7, 0}, {7, 7, 0}, {4, 5, 0}};
+    CHECK(links.add(batch.begin(), batch.end()) == 2);
+    CHECK(links.size() == 4);
+    CHECK(!links.contains(1, 3) && links.contains(7, 6));
+    checkConsistent(links);
+}
+
+void testRemoveAt() {
+    EdgeSet<Link> links;
+    for (int k = 0; k < 5; ++k) links.add({k, k + 10, float(k)});
+
+    // the last link moves into slot 1 and must be found there
+    links.removeAt(1);
+    CHECK(links.size() == 4);
+    CHECK(!links.contains(1, 11));
+    CHECK(links[1].i == 4 && links[1].value == 4);
+    CHECK(links.remove(14, 4));
+    CHECK(links.size() == 3 && !links.contains(4, 14));
+    checkConsistent(links);
+
+    // the last one itself: 2-12, since 3-13 moved into slot 1
+    links.removeAt(links.size() - 1);
+    CHECK(links.size() == 2 && !links.contains(2, 12) && links.contains(3, 13));
+    checkConsistent(links);
+    CHECK(!links.remove(1, 11));
+}
+
+// sorted slots, as applySprings() hands out the broken springs, including
+// the last slot and neighbours of it
+void testRemoveSlots() {
+    std::mt19937 random32(1);
+    for (int round = 0; round < 50; ++round) {
+        EdgeSet<Link> links;
+        int n = 40;
+        for (int k = 0; k < n; ++k) links.add({k, k + 100, float(k)});
+        std::vector<int> slots;
+        for (int k = 0; k < n; ++k)
+            if (random32() % 3 == 0 || (round == 0 && k >= n - 3)) slots.push_back(k);
+        std::set<int> gone;
+        for (int k : slots) gone.insert(links[k].i);
+
+        links.removeAt(slots);
+        CHECK(links.size() == n - slots.size());
+        for (int k = 0; k < n; ++k) CHECK(links.contains(k, k + 100) == !gone.count(k));
+        checkConsistent(links);
+    }
+}
+
+void testRemap() {
+    EdgeSet<Link> links;
+    links.add({0, 1, 1});
+    links.add({1, 2, 2});
+    links.add({2, 3, 3});
+    links.add({0, 3, 4});
+    links.add({3, 4, 5});
+
+    // 1 is removed, 2 and 3 merge into one particle, 4 moves down
+    std::vector<int> to = {0, -1, 1, 1, 2};
+    links.remap(to);
+    // 0-1 and 1-2 go with particle 1; 2-3 becomes 1-1 and goes too; 0-3
+    // and 3-4 become 0-1 and 1-2
+    CHECK(links.size() == 2);
+    CHECK(links.contains(0, 1) && links.contains(1, 2));
+    CHECK(!links.contains(1, 1));
+    checkConsistent(links);
+
+    // two links that become the same pair are merged into one
+    EdgeSet<Link> merging;
+    merging.add({0, 2, 1});
+    merging.add({1, 2, 2});
+    merging.remap({0, 0, 1});
+    CHECK(merging.size() == 1 && merging.contains(0, 1));
+    checkConsistent(merging);
+}
+
+void testCompact() {
+    EdgeSet<Link> links;
+    std::mt19937 random32(2);
+    for (int k = 0; k < 300; ++k) {
+        int i = random32() % 60, j = random32() % 60;
+        links.add({i, j, float(k)});
+    }
+    for (int k = 0; k < 40; ++k) links.removeAt(random32() % links.size());
+    int size = links.size();
+    links.compact();
+    CHECK(links.size() == size);
+
+    // by the lower particle, then the higher
+    for (int k = 1; k < links.size(); ++k) {
+        auto lo = [](const Link& l) { return std::min(l.i, l.j); };
+        auto hi = [](const Link& l) { return std::max(l.i, l.j); };
+        CHECK(lo(links[k - 1]) < lo(links[k]) || (lo(links[k - 1]) == lo(links[k]) && hi(links[k - 1]) < hi(links[k])));
+    }
+    checkConsistent(links);
+
+    // and still removable by slot afterwards
+    links.removeAt(0);
+    checkConsistent(links);
+}
+
+int main() {
+    testAdd();
+    testRemoveAt();
+    testRemoveSlots();
+    testRemap();
+    testCompact();
+    return checkResult("edge set");
+}
@@ -0,0 +1,115 @@
+// feature-stream.hpp: no allocations or locks on the audio path under load.
+//
+// a simulation thread pushes features as fast as it can while allocating
+// and locking a mutex of its own; an audio thread runs what onSound in
+// ass2/particle.cpp does (drain the stream, glide towards the targets,
+// one sine per sample) for many buffers. every operator new and, on
+// linux, every pthread_mutex_lock is counted per thread. the audio
+// thread must do none of either; the simulation thread doing plenty
+// shows that the counting works. (linux: link with -ldl on older glibc)
+
+#include "../feature-stream.hpp"
+#include "check.hpp"
+
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <dlfcn.h>
+#include <pthread.h>
+#endif
+
+thread_local bool onAudioThread = false;
+std::atomic<long> audioAllocations{0}, otherAllocations{0};
+std::atomic<long> audioLocks{0}, otherLocks{0};
+
+void* operator new(size_t bytes) {
+    ++(onAudioThread ? audioAllocations : otherAllocations);
+    if (void* p = std::malloc(bytes ? bytes : 1)) return p;
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+#ifdef __linux__
+// std::mutex ends up here; the real one is the next definition along
+extern "C" int pthread_mutex_lock(pthread_mutex_t* m) {
+    using Lock = int (*)(pthread_mutex_t*);
+    static Lock real = (Lock)dlsym(RTLD_NEXT, "pthread_mutex_lock");
+    ++(onAudioThread ? audioLocks : otherLocks);
+    return real(m);
+}
+#endif
+
+struct StepFeatures {
+    float energy = 0, strain = 0;
+};
+
+int main() {
+    CHECK(std::atomic<size_t>().is_lock_free());
+
+    FeatureStream<StepFeatures> features;
+    std::atomic<bool> done{false};
+    std::atomic<long> pushed{0}, dropped{0}, popped{0};
+
+    std::thread simulation([&]() {
+        std::mutex mutex;
+        std::vector<std::vector<float>> garbage;
+        for (long k = 0; !done; ++k) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                garbage.emplace_back(64, float(k));
+                if (garbage.size() > 100) garbage.clear();
+            }
+            StepFeatures f;
+            f.energy = (k % 1000) / 1000.0f;
+            f.strain = (k % 100) / 100.0f;
+            ++(features.push(f) ? pushed : dropped);
+        }
+    });
+
+    float sink = 0;
+    std::thread audio([&]() {
+        onAudioThread = true;
+        StepFeatures heard;
+        Smoothed pitch, loudness;
+        double phase = 0, sampleRate = 48000;
+        for (int buffer = 0; buffer < 4000; ++buffer) {
+            StepFeatures f;
+            while (features.pop(f)) {
+                heard = f;
+                ++popped;
+            }
+            pitch.target = 110 + 660 * std::min(std::sqrt(heard.energy), 1.0f);
+            loudness.target = heard.energy > 0 ? 0.05f + 0.2f * std::min(heard.strain, 1.0f) : 0;
+            for (int s = 0; s < 512; ++s) {
+                phase += pitch.next() / sampleRate;
+                phase -= std::floor(phase);
+                sink += std::sin(2 * M_PI * phase) * loudness.next();
+            }
+        }
+        onAudioThread = false;
+    });
+
+    audio.join();
+    done = true;
+    simulation.join();
+
+    std::cout << pushed << " pushed, " << dropped << " dropped (ring full), " << popped << " popped; "
+              << otherAllocations << " allocations and " << otherLocks << " locks elsewhere" << std::endl;
+    CHECK(popped > 0);
+    CHECK(popped <= pushed);
+    CHECK(audioAllocations == 0);
+    CHECK(otherAllocations > 0);
+#ifdef __linux__
+    CHECK(audioLocks == 0);
+    CHECK(otherLocks > 0);
+#endif
+    CHECK(std::isfinite(sink));
+    return checkResult("feature stream");
+}
@@ -0,0 +1,152 @@
+// mesh-uploads.hpp: what goes to the GPU for the update pattern of each
+// sketch. plan() is checked frame by frame and sent() stands in for the
+// upload, so no window is needed.
+
+#include "../mesh-uploads.hpp"
+#include "check.hpp"
+
+const int n = 1000;
+
+Mesh cloud(int size, bool texCoords) {
+    Mesh m;
+    m.vertices().resize(size);
+    m.colors().resize(size);
+    if (texCoords) m.texCoord2s().resize(size);
+    return m;
+}
+
+bool is(const MeshUploads::Range& r, int begin, int end) { return r.begin == begin && r.end == end; }
+
+bool none(const MeshUploads::Plan& p) {
+    for (auto& r : p.ranges) {
+        if (!r.empty()) return false;
+    }
+    return !p.full && p.bytes == 0;
+}
+
+// sends what plan() says, as upload() would, and returns it
+MeshUploads::Plan frame(MeshUploads& uploads, const Mesh& m) {
+    MeshUploads::Plan p = uploads.plan(m);
+    uploads.sent(p);
+    return p;
+}
+
+const size_t position = sizeof(Vec3f), color = sizeof(Color), texCoord = sizeof(Vec2f);
+
+// ass2/particle.cpp: positions every step, a texCoord per parked particle,
+// everything after a compaction or a resize
+void testParticles() {
+    MeshUploads uploads;
+    Mesh m = cloud(n, true);
+
+    MeshUploads::Plan p = frame(uploads, m);
+    CHECK(p.full && p.bytes == n * (position + color + texCoord));
+    CHECK(uploads.fullUpdates == 1);
+
+    // a step
+    uploads.mark(MeshUploads::Positions, 0, n);
+    p = frame(uploads, m);
+    CHECK(!p.full && is(p.ranges[MeshUploads::Positions], 0, n));
+    CHECK(p.ranges[MeshUploads::Colors].empty() && p.ranges[MeshUploads::TexCoords].empty());
+    CHECK(p.bytes == n * position);
+
+    // frozen: nothing
+    CHECK(none(frame(uploads, m)));
+
+    // two particles parked in a step: the hull of their texCoords
+    uploads.mark(MeshUploads::TexCoords, 700, 701);
+    uploads.mark(MeshUploads::TexCoords, 30, 31);
+    uploads.mark(MeshUploads::Positions, 0, n);
+    p = frame(uploads, m);
+    CHECK(is(p.ranges[MeshUploads::TexCoords], 30, 701));
+    CHECK(p.bytes == n * position + 671 * texCoord);
+
+    // compaction drops them: new sizes, so everything
+    m = cloud(n - 2, true);
+    uploads.markAll();
+    p = frame(uploads, m);
+    CHECK(p.full && is(p.ranges[MeshUploads::Colors], 0, n - 2) && p.ranges[MeshUploads::Normals].empty());
+    CHECK(uploads.fullUpdates == 2);
+
+    // compaction with nothing killed keeps the sizes: every attribute the
+    // mesh has, without reallocating
+    uploads.markAll();
+    p = frame(uploads, m);
+    CHECK(!p.full && is(p.ranges[MeshUploads::TexCoords], 0, n - 2) && p.ranges[MeshUploads::Normals].empty());
+    CHECK(p.bytes == (n - 2) * (position + color + texCoord));
+
+    // "render": whole positions and colours, marked without a size
+    uploads.mark(MeshUploads::Positions);
+    uploads.mark(MeshUploads::Colors);
+    p = frame(uploads, m);
+    CHECK(is(p.ranges[MeshUploads::Positions], 0, n - 2) && is(p.ranges[MeshUploads::Colors], 0, n - 2));
+    CHECK(p.ranges[MeshUploads::TexCoords].empty());
+}
+
+// a transition between layouts on the CPU: colours when it starts,
+// positions while it runs, nothing when it is over; the culled copy only
+// when the view changes
+void testTransitions() {
+    MeshUploads display, visible;
+    Mesh m = cloud(n, false), shown = cloud(300, false);
+    frame(display, m);
+    frame(visible, shown);
+
+    display.mark(MeshUploads::Colors, 0, n);
+    MeshUploads::Plan p = frame(display, m);
+    CHECK(is(p.ranges[MeshUploads::Colors], 0, n) && p.ranges[MeshUploads::Positions].empty());
+    CHECK(p.bytes == n * color);
+
+    for (int f = 0; f < 3; ++f) {
+        display.mark(MeshUploads::Positions, 0, n);
+        p = frame(display, m);
+        CHECK(!p.full && is(p.ranges[MeshUploads::Positions], 0, n) && p.bytes == n * position);
+    }
+    CHECK(none(frame(display, m)));
+
+    // the same chunks in view: the copy is not even marked
+    CHECK(none(frame(visible, shown)));
+
+    // other chunks: a different size is a full update, the same size is not
+    shown = cloud(420, false);
+    visible.markAll();
+    p = frame(visible, shown);
+    CHECK(p.full && p.bytes == 420 * (position + color));
+    visible.markAll();
+    p = frame(visible, shown);
+    CHECK(!p.full && p.bytes == 420 * (position + color));
+    CHECK(visible.fullUpdates == 2 && display.fullUpdates == 1);
+}
+
+// static clouds: each once, then nothing however often it is drawn
+void testLayouts() {
+    MeshUploads uploads;
+    Mesh m = cloud(n, false);
+    uploads.markAll();
+    CHECK(frame(uploads, m).full);
+    for (int f = 0; f < 5; ++f) CHECK(none(frame(uploads, m)));
+    CHECK(uploads.fullUpdates == 1 && uploads.uploadedBytes == 0);
+}
+
+// marks past the end are cut to the mesh; empty marks are ignored
+void testEdges() {
+    MeshUploads uploads;
+    Mesh m = cloud(10, false);
+    frame(uploads, m);
+    uploads.mark(MeshUploads::Positions, 5, 5);
+    uploads.mark(MeshUploads::Colors, 8, 50);
+    uploads.mark(MeshUploads::Normals, 0, 10);
+    MeshUploads::Plan p = frame(uploads, m);
+    CHECK(p.ranges[MeshUploads::Positions].empty());
+    CHECK(is(p.ranges[MeshUploads::Colors], 8, 10));
+    CHECK(p.ranges[MeshUploads::Normals].empty());  // the mesh has none
+    CHECK(p.bytes == 2 * color);
+}
+
+int main() {
+    testParticles();
+    testTransitions();
+    testLayouts();
+    testEdges();
+    return checkResult("mesh uploads");
+}
@@ -0,0 +1,227 @@
+// point-chunks.hpp: culling and LOD against a synthetic camera. every
+// point inside the view volume must land in a visible chunk (checked
+// point by point in camera space), chunks behind, beyond or beside the
+// view must be culled, and the strides must follow the distance. mixed
+// boxes must hold every point of a transition between two layouts.
+
+#include "../point-chunks.hpp"
+#include "check.hpp"
+
+#include <random>
+
+std::mt19937 random32(1);
+
+float uniform(float a, float b) { return std::uniform_real_distribution<float>(a, b)(random32); }
+
+ViewCamera lookingDownZ(Vec3f pos, float aspect = 1) {
+    ViewCamera cam;
+    cam.pos = pos;
+    cam.forward = Vec3f(0, 0, -1);
+    cam.up = Vec3f(0, 1, 0);
+    cam.right = Vec3f(1, 0, 0);
+    cam.fovy = 60;
+    cam.aspect = aspect;
+    cam.nearClip = 0.1;
+    cam.farClip = 100;
+    return cam;
+}
+
+// any unit forward, with up and right made to fit
+ViewCamera randomCamera() {
+    Vec3f forward(uniform(-1, 1), uniform(-1, 1), uniform(-1, 1));
+    forward.normalize();
+    Vec3f up = std::abs(forward[1]) < 0.9f ? Vec3f(0, 1, 0) : Vec3f(1, 0, 0);
+    Vec3f right = forward.cross(up).normalize();
+    ViewCamera cam;
+    cam.pos = Vec3f(uniform(-30, 30), uniform(-30, 30), uniform(-30, 30));
+    cam.forward = forward;
+    cam.right = right;
+    cam.up = right.cross(forward).normalize();
+    cam.fovy = uniform(20, 100);
+    cam.aspect = uniform(0.5, 2.5);
+    cam.nearClip = uniform(0.01, 1);
+    cam.farClip = uniform(10, 80);
+    return cam;
+}
+
+// the same volume as makeFrustum, point by point in camera coordinates
+bool inView(const ViewCamera& cam, const Vec3f& p) {
+    Vec3f d = p - cam.pos;
+    float z = d.dot(cam.forward), x = d.dot(cam.right), y = d.dot(cam.up);
+    float tanY = std::tan(cam.fovy * 0.5f * float(M_PI) / 180.0f), tanX = tanY * cam.aspect;
+    return z >= cam.nearClip && z <= cam.farClip && std::abs(x) <= z * tanX && std::abs(y) <= z * tanY;
+}
+
+// clusters of 64 points, one chunk each
+std::vector<Vec3f> clusters(int count, float spread, float size) {
+    std::vector<Vec3f> points;
+    for (int c = 0; c < count; ++c) {
+        Vec3f centre(uniform(-spread, spread), uniform(-spread, spread), uniform(-spread, spread));
+        for (int i = 0; i < 64; ++i) {
+            points.push_back(centre + Vec3f(uniform(-size, size), uniform(-size, size), uniform(-size, size)));
+        }
+    }
+    return points;
+}
+
+bool isVisible(const std::vector<VisibleChunk>& visible, int chunk) {
+    for (auto& v : visible) {
+        if (v.chunk == chunk) return true;
+    }
+    return false;
+}
+
+void testChunks() {
+    std::vector<Vec3f> points = clusters(10, 20, 1);
+    points.resize(points.size() - 10);  // a short last chunk
+    auto chunks = makeChunks(points, 64);
+    CHECK(chunks.size() == 10);
+    CHECK(chunks.back().begin == 576 && chunks.back().end == 630);
+    for (auto& c : chunks) {
+        for (int i = c.begin; i < c.end; ++i) {
+            for (int k = 0; k < 3; ++k) CHECK(points[i][k] >= c.min[k] && points[i][k] <= c.max[k]);
+        }
+    }
+
+    // bounds follow the points when they move
+    for (auto& p : points) p += Vec3f(100, 0, 0);
+    updateChunkBounds(chunks, points);
+    CHECK(chunks[0].min[0] > 70);
+}
+
+// boxes in front, behind, beyond the far plane and off to each side
+void testPlacement() {
+    ViewCamera cam = lookingDownZ(Vec3f(0, 0, 10));
+    std::vector<Vec3f> points;
+    const Vec3f centres[] = {
+        Vec3f(0, 0, 0),      // in front
+        Vec3f(0, 0, 20),     // behind
+        Vec3f(0, 0, -200),   // beyond far
+        Vec3f(40, 0, 0),     // right
+        Vec3f(-40, 0, 0),    // left
+        Vec3f(0, 40, 0),     // above
+        Vec3f(0, -40, 0),    // below
+        Vec3f(0, 0, 9.98f),  // closer than near
+    };
+    for (auto& c : centres) {
+        for (int i = 0; i < 64; ++i) points.push_back(c + Vec3f(uniform(-0.01, 0.01), 0, 0));
+    }
+    auto chunks = makeChunks(points, 64);
+    std::vector<VisibleChunk> visible;
+    cullChunks(chunks, cam, 3, visible);
+    CHECK(visible.size() == 1 && visible[0].chunk == 0);
+
+    // a wide enough window sees the sides, but not above or below
+    cullChunks(chunks, lookingDownZ(Vec3f(0, 0, 10), 8), 3, visible);
+    CHECK(isVisible(visible, 3) && isVisible(visible, 4));
+    CHECK(!isVisible(visible, 5) && !isVisible(visible, 6));
+
+    // turned around, only what was behind
+    cam.forward = Vec3f(0, 0, 1);
+    cam.right = Vec3f(-1, 0, 0);
+    cullChunks(chunks, cam, 3, visible);
+    CHECK(visible.size() == 1 && visible[0].chunk == 1);
+}
+
+// random clouds and cameras: no point in view may be in a culled chunk
+void testNothingMissing() {
+    int checked = 0, culled = 0;
+    for (int round = 0; round < 200; ++round) {
+        std::vector<Vec3f> points = clusters(50, 40, 2);
+        auto chunks = makeChunks(points, 64);
+        ViewCamera cam = randomCamera();
+        std::vector<VisibleChunk> visible;
+        cullChunks(chunks, cam, 5, visible);
+        culled += chunks.size() - visible.size();
+        for (int c = 0; c < chunks.size(); ++c) {
+            if (isVisible(visible, c)) continue;
+            for (int i = chunks[c].begin; i < chunks[c].end; ++i) {
+                ++checked;
+                if (inView(cam, points[i])) {
+                    std::cerr << "round " << round << ", chunk " << c << ": ";
+                    CHECK(!inView(cam, points[i]));
+                    break;
+                }
+            }
+        }
+    }
+    // the test means nothing if culling never culls
+    CHECK(culled > 1000 && checked > 0);
+}
+
+void testStrides() {
+    CHECK(lodStride(0, 3) == 1);
+    CHECK(lodStride(3, 3) == 1);
+    CHECK(lodStride(3.01, 3) == 2);
+    CHECK(lodStride(6, 3) == 2);
+    CHECK(lodStride(12.5, 3) == 8);
+    CHECK(lodStride(1e6, 3) == 16);
+    CHECK(lodStride(1e6, 3, 4) == 4);
+
+    // chunks straight ahead at 2, 5, 11 and 47: distance to the nearest
+    // face of each box, which is 0.5 nearer than its centre
+    ViewCamera cam = lookingDownZ(Vec3f(0, 0, 0));
+    std::vector<Vec3f> points;
+    for (float z : {2.5f, 5.5f, 11.5f, 47.5f}) {
+        for (int i = 0; i < 64; ++i) points.push_back(Vec3f(0, 0, -z + (i % 2 ? 0.5f : -0.5f)));
+    }
+    auto chunks = makeChunks(points, 64);
+    std::vector<VisibleChunk> visible;
+    cullChunks(chunks, cam, 3, visible);
+    CHECK(visible.size() == 4);
+    int expected[] = {1, 2, 4, 16};
+    for (int c = 0; c < visible.size() && c < 4; ++c) CHECK(visible[c].stride == expected[c]);
+
+    // further LOD distance, more detail
+    cullChunks(chunks, cam, 12, visible);
+    for (int c = 0; c < visible.size() && c < 4; ++c) CHECK(visible[c].stride == (c < 3 ? 1 : 4));
+
+    // gatherVisible keeps every stride-th point of each chunk
+    Mesh source, out;
+    for (auto& p : points) {
+        source.vertex(p);
+        source.color(Color(1));
+    }
+    cullChunks(chunks, cam, 3, visible);
+    gatherVisible(source, chunks, visible, out);
+    CHECK(out.vertices().size() == 64 + 32 + 16 + 4);
+    CHECK(out.colors().size() == out.vertices().size());
+    CHECK(out.vertices()[64] == points[64] && out.vertices()[65] == points[66]);
+
+    // and the same points stored one element each
+    std::vector<int> ids(points.size()), gathered;
+    for (int i = 0; i < ids.size(); ++i) ids[i] = i;
+    gatherVisible(ids, chunks, visible, gathered);
+    CHECK(gathered.size() == out.vertices().size());
+    CHECK(gathered[64] == 64 && gathered[65] == 66 && gathered.back() == 240);
+}
+
+// points moving in straight lines between two clouds stay inside the
+// mixed boxes of their chunks all the way
+void testTransitionBounds() {
+    std::vector<Vec3f> from = clusters(20, 30, 2), to = clusters(20, 30, 5), at(from.size());
+    auto fromChunks = makeChunks(from, 64), toChunks = makeChunks(to, 64);
+    std::vector<PointChunk> mixed;
+    for (float t : {0.0f, 0.1f, 0.5f, 0.77f, 1.0f}) {
+        lerpChunkBounds(fromChunks, toChunks, t, mixed);
+        CHECK(mixed.size() == fromChunks.size());
+        for (int i = 0; i < from.size(); ++i) at[i] = from[i] * (1 - t) + to[i] * t;
+        for (auto& c : mixed) {
+            for (int i = c.begin; i < c.end; ++i) {
+                for (int k = 0; k < 3; ++k) {
+                    CHECK(at[i][k] >= c.min[k] - 1e-4f && at[i][k] <= c.max[k] + 1e-4f);
+                }
+            }
+        }
+    }
+    CHECK(mixed[3].min == toChunks[3].min && mixed[3].max == toChunks[3].max);
+}
+
+int main() {
+    testChunks();
+    testPlacement();
+    testNothingMissing();
+    testStrides();
+    testTransitionBounds();
+    return checkResult("point chunks");
+}
@@ -0,0 +1,141 @@
+// ass2/spring-network.hpp against brute force: the grid searches must find
+// neighbours as near as looking at every pair does, and exactly the pairs
+// within a radius, for clouds spread in 3D, flat in a plane and on a line
+// (where the grid fits its cells to the axes that are not thin), and for a
+// lattice full of equal distances.
+
+#include "../ass2/spring-network.hpp"
+#include "check.hpp"
+
+#include <random>
+#include <set>
+#include <utility>
+
+std::mt19937 random32(1);
+
+float uniform(float a, float b) { return std::uniform_real_distribution<float>(a, b)(random32); }
+
+std::vector<Vec3f> cloud(int n) {
+    std::vector<Vec3f> p(n);
+    for (auto& v : p) v = Vec3f(uniform(-5, 5), uniform(-5, 5), uniform(-5, 5));
+    return p;
+}
+
+std::vector<Vec3f> plane(int n) {
+    std::vector<Vec3f> p(n);
+    for (auto& v : p) v = Vec3f(uniform(-5, 5), uniform(-5, 5), 2);
+    return p;
+}
+
+std::vector<Vec3f> line(int n) {
+    std::vector<Vec3f> p(n);
+    for (auto& v : p) v = Vec3f(1, 2, 3) * uniform(-5, 5);
+    return p;
+}
+
+// 8 x 8 x 8 points one unit apart: every distance comes many times over
+std::vector<Vec3f> lattice() {
+    std::vector<Vec3f> p;
+    for (int z = 0; z < 8; ++z)
+        for (int y = 0; y < 8; ++y)
+            for (int x = 0; x < 8; ++x) p.push_back(Vec3f(x, y, z));
+    return p;
+}
+
+using Pairs = std::set<std::pair<int, int>>;
+
+float distanceSqr(const std::vector<Vec3f>& p, int i, int j) { return (p[j] - p[i]).magSqr(); }
+
+// the squared distances to the k nearest others of i, nearest first
+std::vector<float> nearestDistances(const std::vector<Vec3f>& p, int i, int k) {
+    std::vector<float> d;
+    for (int j = 0; j < p.size(); ++j)
+        if (j != i) d.push_back(distanceSqr(p, i, j));
+    std::sort(d.begin(), d.end());
+    d.resize(std::min<size_t>(k, d.size()));
+    return d;
+}
+
+Pairs pairsOf(const std::vector<spring>& springs) {
+    Pairs pairs;
+    for (auto& s : springs) pairs.insert({std::min(s.i, s.j), std::max(s.i, s.j)});
+    CHECK(pairs.size() == springs.size());  // no pair twice, either way round
+    return pairs;
+}
+
+void checkLengths(const std::vector<Vec3f>& p, const std::vector<spring>& springs) {
+    for (auto& s : springs) {
+        CHECK(s.i != s.j);
+        CHECK_NEAR(s.length, (p[s.j] - p[s.i]).mag(), 1e-5);
+        CHECK(s.stiffness == 0.5f);
+    }
+}
+
+// the neighbours must be as near as brute force finds: the same sorted
+// distances, since where two are equally near either will do. the springs
+// must be one per neighbour pair, whichever way round it was found
+void checkNearest(const char* name, const std::vector<Vec3f>& p, int k) {
+    PointGrid grid;
+    grid.build(p, 0, k);
+    std::vector<int> nearest = nearestNeighbours(p, k, grid);
+    int wrong = 0;
+    Pairs expected;
+    for (int i = 0; i < p.size(); ++i) {
+        std::vector<float> want = nearestDistances(p, i, k), found;
+        for (int n = 0; n < k; ++n) {
+            int j = nearest[size_t(i) * k + n];
+            if (j < 0) continue;
+            found.push_back(distanceSqr(p, i, j));
+            expected.insert({std::min(i, j), std::max(i, j)});
+        }
+        wrong += found != want;
+    }
+    if (wrong > 0) std::cerr << name << ", k = " << k << ": " << wrong << " particles with the wrong neighbours" << std::endl;
+    CHECK(wrong == 0);
+
+    std::vector<spring> springs;
+    connectNearest(p, k, 0.5f, springs);
+    checkLengths(p, springs);
+    CHECK(pairsOf(springs) == expected);
+}
+
+void checkWithin(const char* name, const std::vector<Vec3f>& p, float radius) {
+    std::vector<spring> springs;
+    connectWithin(p, radius, 0.5f, springs);
+    checkLengths(p, springs);
+    Pairs expected;
+    for (int i = 0; i < p.size(); ++i)
+        for (int j = i + 1; j < p.size(); ++j)
+            if (distanceSqr(p, i, j) < radius * radius) expected.insert({i, j});
+    Pairs found = pairsOf(springs);
+    if (found != expected)
+        std::cerr << name << ": " << found.size() << " pairs within " << radius << ", brute force finds "
+                  << expected.size() << std::endl;
+    CHECK(found == expected);
+    CHECK(!expected.empty());
+}
+
+int main() {
+    // big enough that parallelFor splits the work on any machine with cores
+    for (int k : {1, 6, 13}) {
+        checkNearest("cloud", cloud(3000), k);
+        checkNearest("plane", plane(3000), k);
+        checkNearest("line", line(3000), k);
+        checkNearest("lattice", lattice(), k);
+    }
+    // fewer points than neighbours asked for
+    checkNearest("few", cloud(5), 8);
+
+    for (float radius : {0.3f, 1.0f}) {
+        checkWithin("cloud", cloud(3000), radius);
+        checkWithin("plane", plane(3000), radius);
+        checkWithin("line", line(3000), radius * 0.01f);
+    }
+    checkWithin("lattice", lattice(), 1.5f);
+
+    std::vector<spring> none;
+    connectNearest(std::vector<Vec3f>(1), 6, 1, none);
+    connectWithin(std::vector<Vec3f>(1), 1, 1, none);
+    CHECK(none.empty());
+    return checkResult("spring network");
+}
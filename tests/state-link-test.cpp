@@ -0,0 +1,224 @@
+// state-link.hpp: a simulator and a renderer on this machine, with a relay
+// in between that duplicates, drops and garbles chunks the way a busy
+// network would. every frame the renderer shows must be one the simulator
+// sent (to within the quantisation), and frames missing a chunk must never
+// show. decode() is also fed truncated and random payloads directly.
+
+#include "../state-link.hpp"
+#include "check.hpp"
+
+#include <chrono>
+#include <random>
+#include <thread>
+
+const int serverPort = 9090, relayPort = 9091;
+const Vec3f lo(-20), hi(20);
+
+std::mt19937 random32(1);
+
+float uniform(float a, float b) { return std::uniform_real_distribution<float>(a, b)(random32); }
+
+// new random positions every frame, so even the deltas take several chunks
+WorldState randomState(int n) {
+    WorldState s;
+    for (int i = 0; i < n; ++i) {
+        s.positions.push_back(Vec3f(uniform(-19, 19), uniform(-19, 19), uniform(-19, 19)));
+        s.colors.push_back(Color(0.5f, 0.25f, 1.0f, 1.0f));
+    }
+    return s;
+}
+
+bool near(const WorldState& a, const WorldState& b) {
+    if (a.positions.size() != b.positions.size() || a.colors.size() != b.colors.size()) return false;
+    float quantum = (hi[0] - lo[0]) / 65535.0f;
+    for (int i = 0; i < a.positions.size(); ++i) {
+        for (int k = 0; k < 3; ++k) {
+            if (std::abs(a.positions[i][k] - b.positions[i][k]) > quantum) return false;
+        }
+    }
+    return true;
+}
+
+// stands between the two: the server thinks the relay is the renderer
+class Relay {
+public:
+    enum Fault { Pass, Duplicate, DropLast, DuplicateFirstDropLast, Garble };
+    Fault fault = Pass;
+
+    bool open() {
+        sock = socket(AF_INET, SOCK_DGRAM, 0);
+        int buffer = 4 << 20;  // a whole keyframe, as the client has
+        setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &buffer, sizeof(buffer));
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = htons(relayPort);
+        server = addr;
+        server.sin_port = htons(serverPort);
+        return sock >= 0 && bind(sock, (sockaddr*)&addr, sizeof(addr)) == 0;
+    }
+
+    ~Relay() {
+        if (sock >= 0) close(sock);
+    }
+
+    // forwards until nothing has come for a while
+    void pump() {
+        std::vector<uint8_t> packet(1 << 17);
+        auto quiet = std::chrono::steady_clock::now();
+        while (std::chrono::steady_clock::now() - quiet < std::chrono::milliseconds(30)) {
+            sockaddr_in from{};
+            socklen_t length = sizeof(from);
+            ssize_t n = recvfrom(sock, packet.data(), packet.size(), MSG_DONTWAIT, (sockaddr*)&from, &length);
+            if (n < 0) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                continue;
+            }
+            quiet = std::chrono::steady_clock::now();
+            packet.resize(n);
+            if (from.sin_port == server.sin_port) {
+                toClient(packet);
+            } else {
+                client = from;
+                sendto(sock, packet.data(), packet.size(), 0, (sockaddr*)&server, sizeof(server));
+            }
+            packet.resize(1 << 17);
+        }
+    }
+
+private:
+    int sock = -1;
+    sockaddr_in server{}, client{};
+
+    void send(const std::vector<uint8_t>& packet) {
+        sendto(sock, packet.data(), packet.size(), 0, (sockaddr*)&client, sizeof(client));
+    }
+
+    void toClient(const std::vector<uint8_t>& packet) {
+        statelink::FramePacket h;
+        std::memcpy(&h, packet.data(), sizeof(h));
+        bool last = h.chunk + 1 == h.chunks;
+        switch (fault) {
+            case Pass: send(packet); break;
+            case Duplicate:
+                send(packet);
+                send(packet);
+                break;
+            case DropLast:
+                if (!last) send(packet);
+                break;
+            case DuplicateFirstDropLast:
+                // a bare chunk counter takes the second copy for the missing chunk
+                if (h.chunk == 0) send(packet);
+                if (!last) send(packet);
+                break;
+            case Garble: {
+                send(packet);
+                // the same chunk cut short, out of range, and lying about its size
+                std::vector<uint8_t> bad(packet.begin(), packet.end() - 7);
+                send(bad);
+                bad = packet;
+                statelink::FramePacket b = h;
+                b.chunk = h.chunks + 3;
+                std::memcpy(bad.data(), &b, sizeof(b));
+                send(bad);
+                b = h;
+                b.bytes = 0xfffffff0;
+                std::memcpy(bad.data(), &b, sizeof(b));
+                send(bad);
+                b = h;
+                b.positions = 0x7fffffff;
+                std::memcpy(bad.data(), &b, sizeof(b));
+                send(bad);
+                break;
+            }
+        }
+    }
+};
+
+void testDecode() {
+    std::vector<uint16_t> base(1000), values(1000), out;
+    for (int i = 0; i < 1000; ++i) {
+        base[i] = random32();
+        values[i] = i % 3 ? base[i] : uint16_t(random32());
+    }
+    std::vector<uint8_t> delta, whole;
+    statelink::encode(values, &base, delta);
+    statelink::encode(values, nullptr, whole);
+
+    CHECK(statelink::decode(delta, values.size(), &base, out) && out == values);
+    CHECK(statelink::decode(whole, values.size(), nullptr, out) && out == values);
+
+    // cut short anywhere
+    for (size_t cut = 0; cut < delta.size(); cut += 7) {
+        std::vector<uint8_t> part(delta.begin(), delta.begin() + cut);
+        CHECK(!statelink::decode(part, values.size(), &base, out));
+    }
+    CHECK(!statelink::decode(std::vector<uint8_t>(whole.begin(), whole.end() - 1), values.size(), nullptr, out));
+
+    // a base of the wrong size, or a frame claiming to be enormous
+    std::vector<uint16_t> shortBase(base.begin(), base.end() - 1);
+    CHECK(!statelink::decode(delta, values.size(), &shortBase, out));
+    CHECK(!statelink::decode(whole, size_t(1) << 40, nullptr, out));
+
+    // a zero run longer than what is left
+    std::vector<uint8_t> run;
+    trajectory::putVarint(run, 0);
+    trajectory::putVarint(run, 5000);
+    CHECK(!statelink::decode(run, 1000, &base, out));
+
+    // noise: whatever it says, it must not read or write out of bounds
+    // (build with -fsanitize=address to see that)
+    for (int k = 0; k < 2000; ++k) {
+        std::vector<uint8_t> noise(random32() % 64);
+        for (auto& b : noise) b = random32();
+        statelink::decode(noise, 1000, &base, out);
+        statelink::decode(noise, 1000, nullptr, out);
+    }
+}
+
+void testLoopback() {
+    StateServer server;
+    server.reportEvery = 0;
+    Relay relay;
+    StateClient client;
+    CHECK(server.open(serverPort, lo, hi));
+    CHECK(relay.open());
+    CHECK(client.open("127.0.0.1", relayPort));
+    relay.pump();  // the hello reaches the server
+
+    struct Round {
+        Relay::Fault fault;
+        bool shows;
+    };
+    const Round rounds[] = {
+        {Relay::Pass, true},
+        {Relay::Duplicate, true},
+        {Relay::Pass, true},
+        {Relay::DropLast, false},
+        {Relay::Pass, true},  // a delta against a frame from before the drop
+        {Relay::DuplicateFirstDropLast, false},
+        {Relay::Garble, true},
+        {Relay::Duplicate, true},
+        {Relay::Pass, true},
+    };
+    WorldState shown;
+    for (auto& round : rounds) {
+        WorldState sent = randomState(20000);
+        relay.fault = round.fault;
+        server.send(sent);
+        relay.pump();
+        bool got = client.receive(shown);
+        relay.pump();  // the ack goes back
+
+        if (got != round.shows) std::cerr << "round " << (&round - rounds) << ": ";
+        CHECK(got == round.shows);
+        if (got) CHECK(near(shown, sent));
+    }
+}
+
+int main() {
+    testDecode();
+    testLoopback();
+    return checkResult("state link");
+}
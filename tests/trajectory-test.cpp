@@ -0,0 +1,260 @@
+// trajectory.hpp: a recorded run of fleas closing in on a walking cat
+// plays back to within the quantum of the box around them, which shrinks
+// as they gather, not the quantum of the bounds given to open(). files
+// cut short, with a lying footer or index, or with garbled payloads are
+// refused or fail frame() without reading out of bounds (build with
+// -fsanitize=address to see that). a recorder that falls behind drops
+// frames, which play back as the frame before.
+
+#include "../trajectory.hpp"
+#include "check.hpp"
+
+#include <cstdio>
+#include <random>
+
+const char* path = "trajectory-test.traj";
+const float bound = 250;  // as ass3/stable.cpp records
+
+std::mt19937 random32(1);
+
+float uniform(float a, float b) { return std::uniform_real_distribution<float>(a, b)(random32); }
+
+// the cat first, then fleas that start far out and end up within a few
+// units of it
+std::vector<std::vector<Vec3f>> fleaRun(int frames, int fleas) {
+    std::vector<Vec3f> start(fleas), end(fleas);
+    for (int i = 0; i < fleas; ++i) {
+        start[i] = Vec3f(uniform(-220, 220), uniform(-220, 220), uniform(-220, 220));
+        end[i] = Vec3f(uniform(-2, 2), uniform(0, 1), uniform(-2, 2));
+    }
+    std::vector<std::vector<Vec3f>> run(frames);
+    for (int f = 0; f < frames; ++f) {
+        float t = std::min(f / (frames * 0.5f), 1.0f);
+        Vec3f cat(10 * std::sin(f * 0.01f), 0, 10 * std::cos(f * 0.013f));
+        run[f].push_back(cat);
+        for (int i = 0; i < fleas; ++i) run[f].push_back(cat + start[i] * (1 - t) + end[i] * t);
+    }
+    return run;
+}
+
+std::vector<uint8_t> readFile() {
+    std::vector<uint8_t> bytes;
+    std::FILE* file = std::fopen(path, "rb");
+    if (!file) return bytes;
+    int c;
+    while ((c = std::fgetc(file)) != EOF) bytes.push_back(uint8_t(c));
+    std::fclose(file);
+    return bytes;
+}
+
+void writeFile(const std::vector<uint8_t>& bytes) {
+    std::FILE* file = std::fopen(path, "wb");
+    if (!bytes.empty()) std::fwrite(bytes.data(), 1, bytes.size(), file);
+    std::fclose(file);
+}
+
+float maxError(const std::vector<Vec3f>& a, const std::vector<Vec3f>& b) {
+    float worst = a.size() == b.size() ? 0 : 1e9f;
+    for (int i = 0; i < a.size() && i < b.size(); ++i) {
+        for (int k = 0; k < 3; ++k) worst = std::max(worst, std::abs(a[i][k] - b[i][k]));
+    }
+    return worst;
+}
+
+void testPrecision() {
+    auto run = fleaRun(600, 200);
+    TrajectoryRecorder recorder;
+    recorder.buffers = run.size();  // never behind
+    CHECK(recorder.open(path, Vec3f(-bound), Vec3f(bound)));
+    for (auto& frame : run) recorder.record(frame);
+    CHECK(recorder.dropped() == 0);
+    recorder.close();
+
+    TrajectoryPlayer player;
+    CHECK(player.open(path));
+    CHECK(player.frames() == run.size());
+    std::vector<Vec3f> positions;
+    std::vector<Quatf> orientations;
+
+    // spread out, no better than the bounds allow
+    float wide = 2 * bound / 65535;
+    CHECK(player.frame(0, positions, orientations));
+    float spread = maxError(positions, run[0]);
+    CHECK(spread <= wide);
+
+    // gathered: within a millimetre, where the fixed bounds step by 7.6 mm
+    float gathered = 0;
+    for (int f = 400; f < 600; ++f) {
+        CHECK(player.frame(f, positions, orientations));
+        gathered = std::max(gathered, maxError(positions, run[f]));
+    }
+    std::cout << "max error spread out " << spread << ", gathered " << gathered
+              << " (fixed bounds: " << wide / 2 << ")" << std::endl;
+    CHECK(gathered < 1e-3f);
+
+    // backwards and out of order decodes the same
+    std::vector<Vec3f> again;
+    CHECK(player.frame(123, again, orientations));
+    CHECK(maxError(again, run[123]) <= wide);
+    CHECK(!player.frame(600, again, orientations));
+}
+
+// one buffer, recorded as fast as it copies: the writer falls behind. every
+// frame is still in the file, either as recorded or as the one before
+void testDropped() {
+    auto run = fleaRun(300, 2000);
+    TrajectoryRecorder recorder;
+    recorder.buffers = 1;
+    CHECK(recorder.open(path, Vec3f(-bound), Vec3f(bound)));
+    for (auto& frame : run) recorder.record(frame);
+    int dropped = recorder.dropped();
+    recorder.close();
+
+    TrajectoryPlayer player;
+    CHECK(player.open(path));
+    CHECK(player.frames() == run.size());
+    std::vector<Vec3f> positions, before;
+    std::vector<Quatf> orientations;
+    int repeated = 0;
+    for (int f = 0; f < run.size(); ++f) {
+        CHECK(player.frame(f, positions, orientations));
+        // the cat moves further each frame than the widest quantum
+        if (f > 0 && positions == before) {
+            ++repeated;
+        } else {
+            CHECK(maxError(positions, run[f]) <= 2 * bound / 65535);
+        }
+        before = positions;
+    }
+    std::cout << dropped << " of " << run.size() << " frames dropped" << std::endl;
+    CHECK(repeated == dropped);
+    std::remove(path);
+}
+
+// the file from testPrecision, damaged in every way the reader must survive
+void testDamage() {
+    std::vector<uint8_t> good = readFile();
+    CHECK(good.size() > 1000);
+    // little-endian whatever the host: the magic, then the version
+    CHECK(std::equal(good.begin(), good.begin() + 4, trajectory::magic));
+    CHECK(good[4] == trajectory::version && good[5] == 0 && good[6] == 0 && good[7] == 0);
+    TrajectoryPlayer player;
+    std::vector<Vec3f> positions;
+    std::vector<Quatf> orientations;
+    auto playAll = [&]() {
+        for (int f = 0; f < player.frames(); ++f) player.frame(f, positions, orientations);
+    };
+
+    // cut short anywhere: the footer is gone
+    for (size_t cut : {size_t(0), size_t(10), good.size() / 2, good.size() - 1}) {
+        writeFile(std::vector<uint8_t>(good.begin(), good.begin() + cut));
+        CHECK(!player.open(path));
+    }
+
+    // records written over in place, as the recorder encodes them
+    auto overwrite = [](std::vector<uint8_t>& bytes, uint64_t at, const auto& record) {
+        std::vector<uint8_t> encoded;
+        trajectory::encode(encoded, record);
+        std::copy(encoded.begin(), encoded.end(), bytes.begin() + at);
+    };
+    trajectory::Footer footer;
+    trajectory::decode(good.data() + good.size() - trajectory::footerSize, footer);
+    auto withFooter = [&](const trajectory::Footer& f) {
+        std::vector<uint8_t> bytes = good;
+        overwrite(bytes, bytes.size() - trajectory::footerSize, f);
+        writeFile(bytes);
+    };
+    auto entryAt = [&](uint32_t f) { return footer.indexOffset + f * trajectory::indexEntrySize; };
+
+    // an index outside the file, or more frames than it holds
+    trajectory::Footer bad = footer;
+    bad.indexOffset = good.size() * 4;
+    withFooter(bad);
+    CHECK(!player.open(path));
+    bad = footer;
+    bad.indexOffset = 3;
+    withFooter(bad);
+    CHECK(!player.open(path));
+    bad = footer;
+    bad.frames = footer.frames + 1;
+    withFooter(bad);
+    CHECK(!player.open(path));
+    bad = footer;
+    bad.frames = 0xffffffff;
+    withFooter(bad);
+    CHECK(!player.open(path));
+
+    // index entries pointing outside the frames or at the wrong keyframe
+    for (uint64_t offset : {uint64_t(0), footer.indexOffset - 4, uint64_t(1) << 40}) {
+        std::vector<uint8_t> bytes = good;
+        trajectory::IndexEntry entry;
+        trajectory::decode(bytes.data() + entryAt(7), entry);
+        entry.offset = offset;
+        overwrite(bytes, entryAt(7), entry);
+        writeFile(bytes);
+        CHECK(!player.open(path));
+    }
+    {
+        std::vector<uint8_t> bytes = good;
+        trajectory::IndexEntry entry;
+        trajectory::decode(bytes.data() + entryAt(7), entry);
+        entry.keyframe = 8;
+        overwrite(bytes, entryAt(7), entry);
+        writeFile(bytes);
+        CHECK(!player.open(path));
+    }
+
+    // a frame header claiming more than is there
+    {
+        std::vector<uint8_t> bytes = good;
+        trajectory::IndexEntry entry;
+        trajectory::decode(bytes.data() + entryAt(5), entry);
+        trajectory::FrameHeader fh;
+        trajectory::decode(bytes.data() + entry.offset, fh);
+        fh.bytes = 0x7fffffff;
+        overwrite(bytes, entry.offset, fh);
+        writeFile(bytes);
+        CHECK(!player.open(path));
+    }
+
+    // garbled payloads open, but must not read past them however they
+    // decode: every continuation bit set makes the varints run on
+    {
+        std::vector<uint8_t> bytes = good;
+        for (uint64_t i = trajectory::headerSize; i < footer.indexOffset; ++i) bytes[i] |= 0x80;
+        // the frame headers are payload too here; put them back
+        for (uint32_t f = 0; f < footer.frames; ++f) {
+            trajectory::IndexEntry entry;
+            trajectory::decode(good.data() + entryAt(f), entry);
+            std::copy_n(good.begin() + entry.offset, trajectory::frameHeaderSize, bytes.begin() + entry.offset);
+        }
+        writeFile(bytes);
+        CHECK(player.open(path));
+        CHECK(!player.frame(1, positions, orientations));
+        playAll();
+    }
+
+    // random bytes everywhere but the header and footer
+    for (int round = 0; round < 20; ++round) {
+        std::vector<uint8_t> bytes = good;
+        for (int k = 0; k < 200; ++k) {
+            size_t i = trajectory::headerSize +
+                       random32() % (good.size() - trajectory::headerSize - trajectory::footerSize);
+            bytes[i] = random32();
+        }
+        writeFile(bytes);
+        if (player.open(path)) playAll();
+    }
+
+    writeFile(good);
+    CHECK(player.open(path));
+    CHECK(player.frame(599, positions, orientations));
+    std::remove(path);
+}
+
+int main() {
+    testPrecision();
+    testDamage();
+    testDropped();
+    return checkResult("trajectory");
+}
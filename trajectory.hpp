@@ -0,0 +1,641 @@
+#pragma once
+
+// compressed trajectory files for offline playback and rendering
+//
+//   TrajectoryRecorder recorder;
+//   recorder.open("run.traj", Vec3f(-20), Vec3f(20));
+//   recorder.record(positions, orientations);   // every frame, cheap
+//   recorder.close();
+//
+//   TrajectoryPlayer player;
+//   player.open("run.traj");
+//   player.frame(1234, positions, orientations);
+//
+// positions are quantised to 16 bits inside a box fitted around each
+// keyframe's positions (points outside the bounds given to open() are
+// clamped to them), orientations to 16 bits per quaternion component. so
+// the precision follows how far apart the objects are, not how far they
+// might ever get. a frame keyInterval after the last keyframe, every frame
+// where the number of objects changes and every frame that leaves its keyframe's box is
+// stored whole; the rest are zigzag/varint deltas against the frame before.
+// record() only copies the arrays into one of a fixed pool of frame buffers;
+// quantising, encoding and writing happen on a background thread. when the
+// writer falls behind by the whole pool, record() drops the frame and the
+// file marks it as a repeat of the one before, so frame numbers stay the
+// recorded ones (dropped() counts them).
+//
+// file: header, frames, then an index with the file offset and keyframe of
+// every frame, so the player finds any frame in O(1) and decodes at most
+// keyInterval - 1 deltas (and repeats, which cost nothing) to reach it. open() checks that the index and
+// every frame it points at lie inside the file, and decoding never reads
+// past a frame's payload, so a cut-short or garbled file is refused rather
+// than read out of bounds. every record is written field by field,
+// little-endian and without padding, so a file reads the same on any host.
+
+#include "al/math/al_Quat.hpp"
+#include "al/math/al_Vec.hpp"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace al;
+
+namespace trajectory {
+
+const char magic[4] = {'T', 'R', 'A', 'J'};
+const uint32_t version = 3;
+
+struct Bounds {
+    float min[3], max[3];
+};
+
+struct Header {
+    char magic[4];
+    uint32_t version;
+    Bounds bounds;  // what open() was given: nothing is recorded outside
+    uint32_t keyInterval;
+};
+
+// how a frame's values are stored
+enum Kind : uint8_t {
+    Delta = 0,   // against the frame before
+    Key = 1,     // whole
+    Repeat = 2,  // not at all: the frame before's, for a frame record() dropped
+};
+
+struct FrameHeader {
+    uint8_t kind;
+    uint32_t positions, orientations;
+    uint32_t bytes;  // payload size
+    Bounds bounds;   // positions are quantised in this; a delta keeps its keyframe's
+};
+
+struct IndexEntry {
+    uint64_t offset;
+    uint32_t keyframe;
+};
+
+struct Footer {
+    uint64_t indexOffset;
+    uint32_t frames;
+    char magic[4];
+};
+
+// sizes in the file
+const size_t headerSize = 4 + 4 + 24 + 4;
+const size_t frameHeaderSize = 1 + 4 + 4 + 4 + 24;
+const size_t indexEntrySize = 8 + 4;
+const size_t footerSize = 8 + 4 + 4;
+
+inline void put16(std::vector<uint8_t>& out, uint16_t v) {
+    out.push_back(uint8_t(v));
+    out.push_back(uint8_t(v >> 8));
+}
+inline void put32(std::vector<uint8_t>& out, uint32_t v) {
+    for (int b = 0; b < 32; b += 8) out.push_back(uint8_t(v >> b));
+}
+inline void put64(std::vector<uint8_t>& out, uint64_t v) {
+    for (int b = 0; b < 64; b += 8) out.push_back(uint8_t(v >> b));
+}
+inline void putFloat(std::vector<uint8_t>& out, float v) {
+    uint32_t bits;
+    std::memcpy(&bits, &v, 4);
+    put32(out, bits);
+}
+
+inline uint16_t get16(const uint8_t*& p) {
+    uint16_t v = uint16_t(p[0] | p[1] << 8);
+    p += 2;
+    return v;
+}
+inline uint32_t get32(const uint8_t*& p) {
+    uint32_t v = 0;
+    for (int b = 0; b < 32; b += 8) v |= uint32_t(*p++) << b;
+    return v;
+}
+inline uint64_t get64(const uint8_t*& p) {
+    uint64_t v = 0;
+    for (int b = 0; b < 64; b += 8) v |= uint64_t(*p++) << b;
+    return v;
+}
+inline float getFloat(const uint8_t*& p) {
+    uint32_t bits = get32(p);
+    float v;
+    std::memcpy(&v, &bits, 4);
+    return v;
+}
+
+inline void encode(std::vector<uint8_t>& out, const Bounds& b) {
+    for (float v : b.min) putFloat(out, v);
+    for (float v : b.max) putFloat(out, v);
+}
+inline void decode(const uint8_t*& p, Bounds& b) {
+    for (float& v : b.min) v = getFloat(p);
+    for (float& v : b.max) v = getFloat(p);
+}
+
+inline void encode(std::vector<uint8_t>& out, const Header& h) {
+    out.insert(out.end(), h.magic, h.magic + 4);
+    put32(out, h.version);
+    encode(out, h.bounds);
+    put32(out, h.keyInterval);
+}
+inline void decode(const uint8_t* p, Header& h) {
+    std::memcpy(h.magic, p, 4);
+    p += 4;
+    h.version = get32(p);
+    decode(p, h.bounds);
+    h.keyInterval = get32(p);
+}
+
+inline void encode(std::vector<uint8_t>& out, const FrameHeader& h) {
+    out.push_back(h.kind);
+    put32(out, h.positions);
+    put32(out, h.orientations);
+    put32(out, h.bytes);
+    encode(out, h.bounds);
+}
+inline void decode(const uint8_t* p, FrameHeader& h) {
+    h.kind = *p++;
+    h.positions = get32(p);
+    h.orientations = get32(p);
+    h.bytes = get32(p);
+    decode(p, h.bounds);
+}
+
+inline void encode(std::vector<uint8_t>& out, const IndexEntry& e) {
+    put64(out, e.offset);
+    put32(out, e.keyframe);
+}
+inline void decode(const uint8_t* p, IndexEntry& e) {
+    e.offset = get64(p);
+    e.keyframe = get32(p);
+}
+
+inline void encode(std::vector<uint8_t>& out, const Footer& f) {
+    put64(out, f.indexOffset);
+    put32(out, f.frames);
+    out.insert(out.end(), f.magic, f.magic + 4);
+}
+inline void decode(const uint8_t* p, Footer& f) {
+    f.indexOffset = get64(p);
+    f.frames = get32(p);
+    std::memcpy(f.magic, p, 4);
+}
+
+inline void putVarint(std::vector<uint8_t>& out, uint32_t v) {
+    while (v >= 0x80) {
+        out.push_back(uint8_t(v) | 0x80);
+        v >>= 7;
+    }
+    out.push_back(uint8_t(v));
+}
+
+inline uint32_t getVarint(const uint8_t*& p) {
+    uint32_t v = 0;
+    for (int shift = 0;; shift += 7) {
+        uint8_t byte = *p++;
+        v |= uint32_t(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) return v;
+    }
+}
+
+// the same for input that may be cut short or garbled: false instead of
+// reading past end, or on more than the 5 bytes a uint32_t needs
+inline bool getVarint(const uint8_t*& p, const uint8_t* end, uint32_t& v) {
+    v = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        if (p == end) return false;
+        uint8_t byte = *p++;
+        v |= uint32_t(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) return true;
+    }
+    return false;
+}
+
+inline Vec3f clampTo(const Vec3f& p, const Bounds& b) {
+    return Vec3f(std::min(std::max(p[0], b.min[0]), b.max[0]), std::min(std::max(p[1], b.min[1]), b.max[1]),
+                 std::min(std::max(p[2], b.min[2]), b.max[2]));
+}
+
+// a box around positions (clamped to outer) to quantise them in: padded by
+// an eighth of their extent on each side, so that the frames after them
+// mostly still fit, and by 16 steps of outer's quantum so it is never flat
+inline Bounds fitBounds(const std::vector<Vec3f>& positions, const Bounds& outer) {
+    if (positions.empty()) return outer;
+    Vec3f lo = clampTo(positions[0], outer), hi = lo;
+    for (auto& p : positions) {
+        Vec3f c = clampTo(p, outer);
+        for (int k = 0; k < 3; ++k) {
+            lo[k] = std::min(lo[k], c[k]);
+            hi[k] = std::max(hi[k], c[k]);
+        }
+    }
+    Bounds b;
+    for (int k = 0; k < 3; ++k) {
+        float pad = (hi[k] - lo[k]) / 8 + (outer.max[k] - outer.min[k]) * 16 / 65535.0f;
+        b.min[k] = std::max(lo[k] - pad, outer.min[k]);
+        b.max[k] = std::min(hi[k] + pad, outer.max[k]);
+    }
+    return b;
+}
+
+// whether every position (clamped to outer) is inside b
+inline bool inside(const std::vector<Vec3f>& positions, const Bounds& outer, const Bounds& b) {
+    for (auto& p : positions) {
+        Vec3f c = clampTo(p, outer);
+        for (int k = 0; k < 3; ++k) {
+            if (c[k] < b.min[k] || c[k] > b.max[k]) return false;
+        }
+    }
+    return true;
+}
+
+inline bool operator==(const Bounds& a, const Bounds& b) { return std::memcmp(&a, &b, sizeof(a)) == 0; }
+
+// a position in b as 16 bits, and back
+inline uint16_t quantise(float v, const Bounds& b, int k) {
+    float extent = b.max[k] - b.min[k];
+    float q = extent > 0 ? (v - b.min[k]) * 65535.0f / extent : 0.0f;
+    return uint16_t(std::min(std::max(q, 0.0f), 65535.0f) + 0.5f);
+}
+inline float dequantise(uint16_t v, const Bounds& b, int k) {
+    return b.min[k] + v * (b.max[k] - b.min[k]) / 65535.0f;
+}
+
+inline uint32_t zigzag(int32_t v) { return (uint32_t(v) << 1) ^ uint32_t(v >> 31); }
+inline int32_t unzigzag(uint32_t v) { return int32_t(v >> 1) ^ -int32_t(v & 1); }
+
+}  // namespace trajectory
+
+class TrajectoryRecorder {
+public:
+    int keyInterval = 60;
+    int buffers = 8;  // frames record() can be ahead of the writer; set before open()
+
+    ~TrajectoryRecorder() { close(); }
+
+    bool open(const std::string& path, Vec3f min, Vec3f max) {
+        close();
+        file = std::fopen(path.c_str(), "wb");
+        if (!file) return false;
+
+        trajectory::Header header;
+        std::memcpy(header.magic, trajectory::magic, 4);
+        header.version = trajectory::version;
+        for (int k = 0; k < 3; ++k) {
+            header.bounds.min[k] = min[k];
+            header.bounds.max[k] = max[k];
+        }
+        outer = box = header.bounds;
+        header.keyInterval = keyInterval;
+        bytes.clear();
+        trajectory::encode(bytes, header);
+        std::fwrite(bytes.data(), 1, bytes.size(), file);
+
+        index.clear();
+        previous.clear();
+        pool.resize(std::max(buffers, 1));
+        head = queued = 0;
+        droppedFrames = 0;
+        stopping = false;
+        writer = std::thread([this]() { writeLoop(); });
+        return true;
+    }
+
+    bool recording() const { return file != nullptr; }
+
+    // frames dropped since open() because the writer was behind
+    int dropped() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return droppedFrames;
+    }
+
+    // copies the arrays into a free buffer and returns; the writer thread
+    // does the rest. call from one thread
+    void record(const std::vector<Vec3f>& positions, const std::vector<Quatf>& orientations = {}) {
+        if (!file) return;
+        std::unique_lock<std::mutex> lock(mutex);
+        if (queued == pool.size()) {
+            // the newest frame queued stands in for this one
+            pool[(head + queued - 1) % pool.size()].repeats++;
+            ++droppedFrames;
+            return;
+        }
+        // the writer only touches queued buffers, so this one is ours
+        Frame& frame = pool[(head + queued) % pool.size()];
+        lock.unlock();
+        frame.positions.assign(positions.begin(), positions.end());
+        frame.orientations.assign(orientations.begin(), orientations.end());
+        frame.repeats = 0;
+        lock.lock();
+        ++queued;
+        wake.notify_one();
+    }
+
+    // writes whatever is still queued, the index, and closes the file
+    void close() {
+        if (!file) return;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+            wake.notify_one();
+        }
+        writer.join();
+
+        trajectory::Footer footer;
+        footer.indexOffset = offset();
+        footer.frames = index.size();
+        std::memcpy(footer.magic, trajectory::magic, 4);
+        bytes.clear();
+        for (auto& entry : index) trajectory::encode(bytes, entry);
+        trajectory::encode(bytes, footer);
+        std::fwrite(bytes.data(), 1, bytes.size(), file);
+        std::fclose(file);
+        file = nullptr;
+    }
+
+private:
+    struct Frame {
+        std::vector<Vec3f> positions;
+        std::vector<Quatf> orientations;
+        uint32_t repeats = 0;  // frames dropped after this one
+    };
+
+    std::FILE* file = nullptr;
+    std::thread writer;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::vector<Frame> pool;  // a ring: queued frames from head on
+    size_t head = 0, queued = 0;
+    int droppedFrames = 0;
+    bool stopping = false;
+
+    // only touched by the writer thread (and by open() and close() while
+    // there is none)
+    trajectory::Bounds outer, box;  // open()'s bounds, the current keyframe's
+    std::vector<uint16_t> previous, current;
+    std::vector<uint8_t> bytes, payload;
+    std::vector<trajectory::IndexEntry> index;
+    uint32_t lastKey = 0;
+    size_t previousPositions = 0, previousOrientations = 0;
+
+    uint64_t offset() { return uint64_t(std::ftell(file)); }
+
+    void writeLoop() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            wake.wait(lock, [this]() { return stopping || queued > 0; });
+            if (queued == 0 && stopping) return;
+            Frame& frame = pool[head];
+            lock.unlock();
+            write(frame);
+            lock.lock();
+            // record() may have added repeats while this was written
+            uint32_t repeats = frame.repeats;
+            head = (head + 1) % pool.size();
+            --queued;
+            lock.unlock();
+            for (uint32_t r = 0; r < repeats; ++r) repeat();
+            lock.lock();
+        }
+    }
+
+    void write(const Frame& frame) {
+        uint32_t number = index.size();
+        size_t values = frame.positions.size() * 3 + frame.orientations.size() * 4;
+        bool key = number == 0 || number - lastKey >= uint32_t(keyInterval) || values != previous.size() ||
+                   frame.positions.size() != previousPositions ||
+                   !trajectory::inside(frame.positions, outer, box);
+        if (key) box = trajectory::fitBounds(frame.positions, outer);
+
+        current.clear();
+        for (auto& p : frame.positions) {
+            for (int k = 0; k < 3; ++k) current.push_back(trajectory::quantise(p[k], box, k));
+        }
+        for (auto& o : frame.orientations) {
+            for (float c : {o.w, o.x, o.y, o.z}) {
+                float q = (c + 1.0f) * 32767.5f;
+                current.push_back(uint16_t(std::min(std::max(q, 0.0f), 65535.0f) + 0.5f));
+            }
+        }
+
+        payload.clear();
+        if (key) {
+            for (uint16_t v : current) trajectory::put16(payload, v);
+            lastKey = number;
+        } else {
+            for (size_t i = 0; i < current.size(); ++i) {
+                trajectory::putVarint(payload, trajectory::zigzag(int32_t(current[i]) - int32_t(previous[i])));
+            }
+        }
+
+        writeFrame(key ? trajectory::Key : trajectory::Delta, frame.positions.size(), frame.orientations.size());
+        previous.swap(current);
+        previousPositions = frame.positions.size();
+        previousOrientations = frame.orientations.size();
+    }
+
+    // a dropped frame: the one before again, with no payload
+    void repeat() {
+        payload.clear();
+        writeFrame(trajectory::Repeat, previousPositions, previousOrientations);
+    }
+
+    void writeFrame(trajectory::Kind kind, size_t positions, size_t orientations) {
+        index.push_back({offset(), lastKey});
+        trajectory::FrameHeader header{kind, uint32_t(positions), uint32_t(orientations), uint32_t(payload.size()),
+                                       box};
+        bytes.clear();
+        trajectory::encode(bytes, header);
+        std::fwrite(bytes.data(), 1, bytes.size(), file);
+        std::fwrite(payload.data(), 1, payload.size(), file);
+    }
+};
+
+class TrajectoryPlayer {
+public:
+    ~TrajectoryPlayer() { close(); }
+
+    bool open(const std::string& path) {
+        close();
+#if defined(__unix__) || defined(__APPLE__)
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat info;
+        if (fstat(fd, &info) == 0 && info.st_size > 0) {
+            size = info.st_size;
+            void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            data = mapped == MAP_FAILED ? nullptr : static_cast<const uint8_t*>(mapped);
+        }
+        ::close(fd);
+#else
+        std::ifstream in(path, std::ios::binary);
+        contents.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        data = contents.empty() ? nullptr : contents.data();
+        size = contents.size();
+#endif
+        if (!data || size < trajectory::headerSize + trajectory::footerSize) {
+            close();
+            return false;
+        }
+
+        trajectory::decode(data, header);
+        trajectory::Footer footer;
+        trajectory::decode(data + size - trajectory::footerSize, footer);
+        if (std::memcmp(header.magic, trajectory::magic, 4) || std::memcmp(footer.magic, trajectory::magic, 4) ||
+            header.version != trajectory::version) {
+            close();
+            return false;
+        }
+        // the index sits between the frames and the footer
+        uint64_t indexEnd = size - trajectory::footerSize;
+        if (footer.indexOffset < trajectory::headerSize || footer.indexOffset > indexEnd ||
+            footer.frames > (indexEnd - footer.indexOffset) / trajectory::indexEntrySize) {
+            close();
+            return false;
+        }
+        count = footer.frames;
+        index = data + footer.indexOffset;
+        if (!checkFrames(footer.indexOffset)) {
+            close();
+            return false;
+        }
+        decoded = -1;
+        return true;
+    }
+
+    void close() {
+#if defined(__unix__) || defined(__APPLE__)
+        if (data) munmap(const_cast<uint8_t*>(data), size);
+#else
+        contents.clear();
+#endif
+        data = nullptr;
+        count = 0;
+    }
+
+    int frames() const { return count; }
+
+    bool frame(int i, std::vector<Vec3f>& positions, std::vector<Quatf>& orientations) {
+        if (i < 0 || i >= count) return false;
+
+        trajectory::IndexEntry e = entry(i);
+        // continue from the frame decoded last time when that is on the way
+        int from = decoded >= int(e.keyframe) && decoded <= i ? decoded + 1 : e.keyframe;
+        for (int f = from; f <= i; ++f) {
+            if (!decode(f)) return false;
+        }
+
+        trajectory::FrameHeader fh = frameHeader(i);
+        positions.resize(fh.positions);
+        orientations.resize(fh.orientations);
+        for (uint32_t p = 0; p < fh.positions; ++p) {
+            for (int k = 0; k < 3; ++k) positions[p][k] = trajectory::dequantise(values[p * 3 + k], fh.bounds, k);
+        }
+        for (uint32_t o = 0; o < fh.orientations; ++o) {
+            const uint16_t* q = &values[fh.positions * 3 + o * 4];
+            auto c = [](uint16_t v) { return v / 32767.5f - 1.0f; };
+            orientations[o] = Quatf(c(q[0]), c(q[1]), c(q[2]), c(q[3])).normalize();
+        }
+        return true;
+    }
+
+private:
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+    trajectory::Header header;
+    const uint8_t* index = nullptr;
+    int count = 0;
+    int decoded = -1;
+    std::vector<uint16_t> values;
+#if !defined(__unix__) && !defined(__APPLE__)
+    std::vector<uint8_t> contents;
+#endif
+
+    trajectory::IndexEntry entry(int i) {
+        trajectory::IndexEntry e;
+        trajectory::decode(index + size_t(i) * trajectory::indexEntrySize, e);
+        return e;
+    }
+
+    trajectory::FrameHeader frameHeader(int i) {
+        trajectory::FrameHeader fh;
+        trajectory::decode(data + entry(i).offset, fh);
+        return fh;
+    }
+
+    static uint64_t valueCount(const trajectory::FrameHeader& fh) {
+        return uint64_t(fh.positions) * 3 + uint64_t(fh.orientations) * 4;
+    }
+
+    // every frame inside [headerSize, end), sized the way its kind needs,
+    // after a keyframe with the same counts as the frame before
+    bool checkFrames(uint64_t end) {
+        trajectory::FrameHeader before{};
+        for (int i = 0; i < count; ++i) {
+            trajectory::IndexEntry e = entry(i);
+            if (e.offset < trajectory::headerSize || e.offset > end ||
+                end - e.offset < trajectory::frameHeaderSize) {
+                return false;
+            }
+            trajectory::FrameHeader fh = frameHeader(i);
+            if (fh.bytes > end - e.offset - trajectory::frameHeaderSize) return false;
+            if (e.keyframe > uint32_t(i) || frameHeader(e.keyframe).kind != trajectory::Key) return false;
+            uint64_t n = valueCount(fh);
+            if (fh.kind == trajectory::Key) {
+                if (fh.bytes != n * sizeof(uint16_t)) return false;
+            } else if (fh.kind > trajectory::Repeat || i == 0 || fh.positions != before.positions ||
+                       fh.orientations != before.orientations) {
+                return false;
+            } else if (fh.kind == trajectory::Delta ? fh.bytes < n : fh.bytes != 0) {
+                return false;
+            }
+            before = fh;
+        }
+        return true;
+    }
+
+    // false if a delta runs past the payload; the next frame() starts over
+    // from its keyframe
+    bool decode(int i) {
+        trajectory::FrameHeader fh = frameHeader(i);
+        const uint8_t* p = data + entry(i).offset + trajectory::frameHeaderSize;
+        const uint8_t* end = p + fh.bytes;
+        size_t n = valueCount(fh);
+
+        if (fh.kind == trajectory::Key) {
+            values.resize(n);
+            for (size_t v = 0; v < n; ++v) values[v] = trajectory::get16(p);
+        } else {
+            bool ok = values.size() == n;
+            for (size_t v = 0; ok && fh.kind == trajectory::Delta && v < n; ++v) {
+                uint32_t z;
+                ok = trajectory::getVarint(p, end, z);
+                if (ok) values[v] = uint16_t(int32_t(values[v]) + trajectory::unzigzag(z));
+            }
+            if (!ok) {
+                decoded = -1;
+                return false;
+            }
+        }
+        decoded = i;
+        return true;
+    }
+};